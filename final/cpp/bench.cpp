@@ -0,0 +1,131 @@
+#include "bench.hpp"
+#include "costs.hpp"
+#include "estimating.hpp"
+#include "globla.hpp"
+#include "simd.hpp"
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+/* Compares tile sizes of the local matchers, a synthetic 3000x2000 pair is
+ * used when no images are given.
+ */
+void Usage(char **argv) {
+    fprintf(stderr,
+            "Usage: %s [<left-image> <right-image>] [ndisp] [radius]\n",
+            argv[0]);
+}
+
+/* SAD with the previous traversal, every disparity is aggregated over the
+ * whole image before moving on to the next one.
+ */
+cv::Mat untiled_SAD(cv::Mat const &left_image, cv::Mat const &right_image,
+                    int const &wr, int const &ndisp) {
+    int     rows = left_image.rows;
+    int     cols = left_image.cols;
+    cv::Mat limg, rimg;
+    cv::cvtColor(left_image, limg, cv::COLOR_BGR2GRAY);
+    cv::cvtColor(right_image, rimg, cv::COLOR_BGR2GRAY);
+
+    cv::Mat disparity(rows, cols, CV_32SC1);
+    cv::Mat min_diff(rows, cols, CV_32SC1);
+    disparity = 0;
+    min_diff  = std::numeric_limits<int>::max();
+    cv::Mat cur_diff;
+    for (int d = 0; d < ndisp; ++d) {
+        sad_slice(limg, rimg, wr, d, cur_diff);
+        int xlo = wr + ndisp;
+        int xhi = cols - wr;
+        simd::dispatch([&](auto isa) {
+#pragma omp parallel for
+            for (int y = wr; y < rows - wr; ++y) {
+                decltype(isa)::argmin_update(
+                    cur_diff.ptr<int>(y) + xlo, min_diff.ptr<int>(y) + xlo,
+                    disparity.ptr<int>(y) + xlo, xhi - xlo, d);
+            }
+        });
+    }
+    return disparity;
+}
+
+int main(int argc, char **argv) {
+    /* [Parse args] */
+    cv::Mat limg, rimg, truth;
+    int     argi  = 1;
+    int     ndisp = 256;
+    int     wr    = 5;
+    if (argc >= 3 && !std::isdigit(argv[1][0])) {
+        limg = cv::imread(argv[1], cv::IMREAD_COLOR);
+        rimg = cv::imread(argv[2], cv::IMREAD_COLOR);
+        if (limg.empty() || rimg.empty()) {
+            Usage(argv);
+            return 1;
+        }
+        argi = 3;
+    }
+    if (argi < argc) {
+        ndisp = std::stoi(argv[argi++]);
+    }
+    if (argi < argc) {
+        wr = std::stoi(argv[argi++]);
+    }
+    if (limg.empty()) {
+        synthesize(2000, 3000, ndisp, limg, rimg, truth);
+    }
+    MiscConf conf{};
+    conf.ndisp = ndisp;
+    /* [/Parse args] */
+
+    int rows = limg.rows;
+    int cols = limg.cols;
+    vprintf("%dx%d pixels, %d disparities, window radius %d, %s kernels\n",
+            cols, rows, ndisp, wr, simd::name(simd::detect()));
+
+    using clock  = std::chrono::steady_clock;
+    auto measure = [&](std::string const &name, auto const &run) {
+        auto    start = clock::now();
+        cv::Mat disp  = run();
+        auto    end   = clock::now();
+        flt     secs  = std::chrono::duration<flt>(end - start).count();
+        /* Fraction of pixels within 1 of the ground truth, if known */
+        flt accuracy = -1;
+        if (!truth.empty()) {
+            int good = 0, total = 0;
+            for (int y = wr; y < rows - wr; ++y) {
+                for (int x = wr + ndisp; x < cols - wr; ++x) {
+                    good += std::abs(disp.at<int>(y, x) -
+                                     truth.at<int>(y, x)) <= 1;
+                    ++total;
+                }
+            }
+            accuracy = 1.0 * good / total;
+        }
+        printf("\33[2K%-12s %9.1f ms %9.1f Mcost/s", name.c_str(),
+               secs * 1e3, 1e-6 * rows * cols * ndisp / secs);
+        if (accuracy >= 0) {
+            printf("  accuracy %.4f", accuracy);
+        }
+        printf("\n");
+    };
+
+    measure("untiled",
+            [&] { return untiled_SAD(limg, rimg, wr, conf.ndisp); });
+    std::vector<cv::Size> tiles = {{32, 32},   {64, 32},   {64, 64},
+                                   {128, 64},  {128, 128}, {256, 64},
+                                   {256, 128}, {512, 256}, {cols, 16}};
+    for (cv::Size const &tile : tiles) {
+        std::string name =
+            std::to_string(tile.width) + "x" + std::to_string(tile.height);
+        measure(name, [&] { return SAD(limg, rimg, wr, conf, tile); });
+    }
+
+    return 0;
+}
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 17:30 [CST]
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "globla.hpp"
+
+#include <random>
+
+#include <opencv2/opencv.hpp>
+
+/* Synthetic rectified pair, a textured background at 1/4 of the disparity
+ * range with a foreground rectangle at 3/4 of it.
+ */
+inline void synthesize(int const &rows, int const &cols, int const &ndisp,
+                       cv::Mat &limg, cv::Mat &rimg, cv::Mat &truth) {
+    std::mt19937 rng(0);
+    int          width = cols + ndisp;
+    /* Texture wider than the images, smoothed horizontally */
+    cv::Mat tex(rows, width, CV_8UC1);
+    for (int y = 0; y < rows; ++y) {
+        uint8_t *t    = tex.ptr<uint8_t>(y);
+        int      prev = rng() % 256;
+        for (int x = 0; x < width; ++x) {
+            prev = (prev + int(rng() % 256)) / 2;
+            t[x] = prev;
+        }
+    }
+    limg.create(rows, cols, CV_8UC3);
+    rimg.create(rows, cols, CV_8UC3);
+    truth.create(rows, cols, CV_32SC1);
+    for (int y = 0; y < rows; ++y) {
+        uint8_t const *t = tex.ptr<uint8_t>(y);
+        for (int x = 0; x < cols; ++x) {
+            /* Unrelated texture where the right view sees nothing */
+            rimg.at<cv::Vec3b>(y, x) = cv::Vec3b(t[x], t[x], t[x]);
+            bool fg = inrange(y, rows / 4, rows * 3 / 4) &&
+                      inrange(x, cols / 3, cols * 2 / 3);
+            truth.at<int>(y, x) = fg ? ndisp * 3 / 4 : ndisp / 4;
+            /* Left pixel (y, x) sees texture column x + ndisp */
+            limg.at<cv::Vec3b>(y, x) =
+                cv::Vec3b(t[x + ndisp], t[x + ndisp], t[x + ndisp]);
+        }
+        /* Right pixel (y, x - d) sees the same texture column as left pixel
+         * (y, x), the foreground is written last so that it occludes.
+         */
+        for (int x = 0; x < cols; ++x) {
+            if (truth.at<int>(y, x) == ndisp / 4 && x >= ndisp / 4) {
+                rimg.at<cv::Vec3b>(y, x - ndisp / 4) =
+                    limg.at<cv::Vec3b>(y, x);
+            }
+        }
+        for (int x = 0; x < cols; ++x) {
+            int d = truth.at<int>(y, x);
+            if (d != ndisp / 4 && x >= d) {
+                rimg.at<cv::Vec3b>(y, x - d) = limg.at<cv::Vec3b>(y, x);
+            }
+        }
+    }
+}
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 18:10 [CST]
@@ -0,0 +1,106 @@
+#include "bench.hpp"
+#include "costvolume.hpp"
+#include "estimating.hpp"
+#include "globla.hpp"
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <omp.h>
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+/* Compares the maxflow algorithms of the expansion moves of
+ * `global_optimization()`, a synthetic 640x480 pair is used when no images
+ * are given.
+ */
+void Usage(char **argv) {
+    fprintf(stderr,
+            "Usage: %s [<left-image> <right-image>] [ndisp] [max_iter]\n",
+            argv[0]);
+}
+
+int main(int argc, char **argv) {
+    /* [Parse args] */
+    cv::Mat limg, rimg, truth;
+    int     argi     = 1;
+    int     ndisp    = 64;
+    int     max_iter = 2;
+    if (argc >= 3 && !std::isdigit(argv[1][0])) {
+        limg = cv::imread(argv[1], cv::IMREAD_COLOR);
+        rimg = cv::imread(argv[2], cv::IMREAD_COLOR);
+        if (limg.empty() || rimg.empty()) {
+            Usage(argv);
+            return 1;
+        }
+        argi = 3;
+    }
+    if (argi < argc) {
+        ndisp = std::stoi(argv[argi++]);
+    }
+    if (argi < argc) {
+        max_iter = std::stoi(argv[argi++]);
+    }
+    if (limg.empty()) {
+        synthesize(480, 640, ndisp, limg, rimg, truth);
+    }
+    MiscConf conf{};
+    conf.ndisp = ndisp;
+    /* [/Parse args] */
+
+    int rows = limg.rows;
+    int cols = limg.cols;
+    int wr   = 3;
+    vprintf("%dx%d pixels, %d disparities, %d expansion cycles, %d "
+            "threads\n",
+            cols, rows, ndisp, max_iter, omp_get_max_threads());
+
+    /* Every algorithm gets the same expansion moves as long as their cuts
+     * agree, the data costs are the ones `main` uses.
+     */
+    CostVolume<uint8_t> volume;
+    NCC(limg, rimg, wr, conf, volume);
+
+    using clock = std::chrono::steady_clock;
+    cv::Mat reference;
+    auto    measure = [&](std::string const &name, bool const &push_relabel) {
+        auto    start = clock::now();
+        cv::Mat disp  = global_optimization(volume, conf, max_iter, 1, 0, 1,
+                                           false, push_relabel);
+        auto    end   = clock::now();
+        flt     secs  = std::chrono::duration<flt>(end - start).count();
+        /* Fraction of pixels within 1 of the ground truth, if known */
+        flt accuracy = -1;
+        if (!truth.empty()) {
+            int good = 0, total = 0;
+            for (int y = wr; y < rows - wr; ++y) {
+                for (int x = wr + ndisp; x < cols - wr; ++x) {
+                    good += std::abs(disp.at<int>(y, x) -
+                                     truth.at<int>(y, x)) <= 1;
+                    ++total;
+                }
+            }
+            accuracy = 1.0 * good / total;
+        }
+        /* Minimum cuts are not unique, so the labels may differ slightly */
+        if (reference.empty()) {
+            reference = disp;
+        }
+        flt differ = 1.0 * cv::countNonZero(disp != reference) / disp.total();
+        printf("\33[2K%-14s %9.1f ms  differ %.4f", name.c_str(), secs * 1e3,
+               differ);
+        if (accuracy >= 0) {
+            printf("  accuracy %.4f", accuracy);
+        }
+        printf("\n");
+    };
+
+    measure("bk", false);
+    measure("push-relabel", true);
+
+    return 0;
+}
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 18:10 [CST]
@@ -84,19 +84,25 @@ void GCException::Report() {
 GCoptimization::GCoptimization(SiteID nSites, LabelID nLabels)
     : m_num_labels(nLabels), m_num_sites(nSites), m_datacostIndividual(0),
       m_smoothcostIndividual(0), m_labelcostsAll(0), m_labelcostsByLabel(0),
-      m_labelcostCount(0), m_smoothcostFn(0), m_datacostFn(0),
-      m_numNeighborsTotal(0),
+      m_labelcostCount(0), m_moveLogEnabled(false), m_cycle(0),
+      m_smoothcostFn(0), m_datacostFn(0), m_numNeighborsTotal(0),
       m_queryActiveSitesExpansion(
           &GCoptimization::queryActiveSitesExpansion<DataCostFnFromArray>),
       m_setupDataCostsSwap(0), m_setupDataCostsExpansion(0),
       m_setupSmoothCostsSwap(0), m_setupSmoothCostsExpansion(0),
       m_applyNewLabeling(0), m_updateLabelingDataCosts(0),
-      m_giveSmoothEnergyInternal(0),
+      m_giveSmoothEnergyInternal(0), m_setupDataCostsDynamic(0),
+      m_setupSmoothCostsDynamic(0), m_applyDynamicLabeling(0),
+      m_setupDataCostsGrid(0), m_setupSmoothCostsGrid(0),
+      m_applyGridLabeling(0),
       m_solveSpecialCases(
           &GCoptimization::solveSpecialCases<DataCostFnFromArray>),
       m_datacostFnDelete(0), m_smoothcostFnDelete(0),
       m_random_label_order(false), m_verbosity(0), m_labelingInfoDirty(true),
       m_lookupSiteVar(new SiteID[nSites]), m_labeling(new LabelID[nSites]),
+      m_activeSites(new SiteID[nSites]), m_energy(0), m_dynamicGraphs(0),
+      m_dynamicEdges(0), m_gridWidth(0), m_gridHeight(0), m_gridWeights(0),
+      m_gridEnergy(0), m_gridAlgorithm(GridEnergyT::BOYKOV_KOLMOGOROV),
       m_labelTable(new LabelID[nLabels]),
       m_labelingDataCosts(new EnergyTermType[nSites]),
       m_labelCounts(new SiteID[nLabels]),
@@ -107,9 +113,11 @@ GCoptimization::GCoptimization(SiteID nSites, LabelID nLabels)
     if (nSites <= 0)
         handleError("Number of sites must be >= 1");
 
-    if (!m_lookupSiteVar || !m_labelTable || !m_labeling) {
+    if (!m_lookupSiteVar || !m_activeSites || !m_labelTable || !m_labeling) {
         if (m_lookupSiteVar)
             delete[] m_lookupSiteVar;
+        if (m_activeSites)
+            delete[] m_activeSites;
         if (m_labelTable)
             delete[] m_labelTable;
         if (m_labeling)
@@ -132,6 +140,10 @@ GCoptimization::GCoptimization(SiteID nSites, LabelID nLabels)
 GCoptimization::~GCoptimization() {
     delete[] m_labelTable;
     delete[] m_lookupSiteVar;
+    delete[] m_activeSites;
+    delete m_energy;
+    delete m_gridEnergy;
+    deleteDynamicGraphs();
     delete[] m_labeling;
     delete[] m_labelingDataCosts;
     delete[] m_labelCounts;
@@ -210,6 +222,46 @@ void GCoptimization::applyNewLabeling<GCoptimization::DataCostFnSparse>(
 
 //-------------------------------------------------------------------
 
+template <>
+void GCoptimization::setupDataCostsGrid<GCoptimization::DataCostFnSparse>(
+    SiteID size, LabelID alpha_label, GridEnergyT *e, SiteID *activeSites) {
+    DataCostFnSparse *         dc     = (DataCostFnSparse *)m_datacostFn;
+    DataCostFnSparse::iterator dciter = dc->begin(alpha_label);
+    for (SiteID i = 0; i < size; ++i) {
+        SiteID site = activeSites[i];
+        while (dciter.site() != site)
+            ++dciter;
+        addterm1_checked(e, site, dciter.cost(), m_labelingDataCosts[site]);
+    }
+}
+
+//-------------------------------------------------------------------
+
+template <>
+void GCoptimization::applyGridLabeling<GCoptimization::DataCostFnSparse>(
+    GridEnergyT *e, SiteID *activeSites, SiteID size, LabelID alpha_label) {
+    DataCostFnSparse *         dc     = (DataCostFnSparse *)m_datacostFn;
+    DataCostFnSparse::iterator dciter = dc->begin(alpha_label);
+    for (SiteID i = 0; i < size; i++) {
+        SiteID site = activeSites[i];
+        if (e->get_var(site) == 0) {
+            LabelID prev     = m_labeling[site];
+            m_labeling[site] = alpha_label;
+            m_labelCounts[alpha_label]++;
+            m_labelCounts[prev]--;
+            while (dciter.site() != site)
+                ++dciter;
+            m_labelingDataCosts[site] = dciter.cost();
+        }
+    }
+    m_labelingInfoDirty = true;
+    updateLabelingInfo(
+        false, true,
+        false); // labels have changed, so update necessary labeling info
+}
+
+//-------------------------------------------------------------------
+
 template <typename UserFunctor>
 void GCoptimization::specializeDataCostFunctor(const UserFunctor f) {
     if (m_datacostFnDelete)
@@ -228,6 +280,12 @@ void GCoptimization::specializeDataCostFunctor(const UserFunctor f) {
     m_applyNewLabeling   = &GCoptimization::applyNewLabeling<UserFunctor>;
     m_updateLabelingDataCosts =
         &GCoptimization::updateLabelingDataCosts<UserFunctor>;
+    m_setupDataCostsDynamic =
+        &GCoptimization::setupDataCostsDynamic<UserFunctor>;
+    m_applyDynamicLabeling =
+        &GCoptimization::applyDynamicLabeling<UserFunctor>;
+    m_setupDataCostsGrid = &GCoptimization::setupDataCostsGrid<UserFunctor>;
+    m_applyGridLabeling  = &GCoptimization::applyGridLabeling<UserFunctor>;
     m_solveSpecialCases = &GCoptimization::solveSpecialCases<UserFunctor>;
 }
 
@@ -247,6 +305,10 @@ void GCoptimization::specializeSmoothCostFunctor(const UserFunctor f) {
         &GCoptimization::setupSmoothCostsExpansion<UserFunctor>;
     m_setupSmoothCostsSwap =
         &GCoptimization::setupSmoothCostsSwap<UserFunctor>;
+    m_setupSmoothCostsDynamic =
+        &GCoptimization::setupSmoothCostsDynamic<UserFunctor>;
+    m_setupSmoothCostsGrid =
+        &GCoptimization::setupSmoothCostsGrid<UserFunctor>;
 }
 
 //-------------------------------------------------------------------
@@ -272,7 +334,8 @@ GCoptimization::EnergyType GCoptimization::giveSmoothEnergyInternal() {
 
 //-------------------------------------------------------------------
 
-OLGA_INLINE void GCoptimization::addterm1_checked(EnergyT *e, VarID i,
+template <typename E>
+OLGA_INLINE void GCoptimization::addterm1_checked(E *e, VarID i,
                                                   EnergyTermType e0,
                                                   EnergyTermType e1) {
     if (e0 > GCO_MAX_ENERGYTERM || e1 > GCO_MAX_ENERGYTERM)
@@ -282,7 +345,8 @@ OLGA_INLINE void GCoptimization::addterm1_checked(EnergyT *e, VarID i,
     e->add_term1(i, e0, e1);
 }
 
-OLGA_INLINE void GCoptimization::addterm1_checked(EnergyT *e, VarID i,
+template <typename E>
+OLGA_INLINE void GCoptimization::addterm1_checked(E *e, VarID i,
                                                   EnergyTermType e0,
                                                   EnergyTermType e1,
                                                   EnergyTermType w) {
@@ -296,8 +360,9 @@ OLGA_INLINE void GCoptimization::addterm1_checked(EnergyT *e, VarID i,
     e->add_term1(i, e0 * w, e1 * w);
 }
 
+template <typename E>
 OLGA_INLINE void GCoptimization::addterm2_checked(
-    EnergyT *e, VarID i, VarID j, EnergyTermType e00, EnergyTermType e01,
+    E *e, VarID i, VarID j, EnergyTermType e00, EnergyTermType e01,
     EnergyTermType e10, EnergyTermType e11, EnergyTermType w) {
     if (e00 > GCO_MAX_ENERGYTERM || e11 > GCO_MAX_ENERGYTERM ||
         e01 > GCO_MAX_ENERGYTERM || e10 > GCO_MAX_ENERGYTERM)
@@ -456,6 +521,217 @@ template <typename DataCostT> void GCoptimization::updateLabelingDataCosts() {
 
 //-----------------------------------------------------------------------------------
 
+template <typename DataCostT>
+void GCoptimization::setupDataCostsDynamic(LabelID       alpha_label,
+                                           DynamicGraph *g, SiteID size) {
+    DataCostT *dc = (DataCostT *)m_datacostFn;
+    if (size < 0) {
+        for (SiteID site = 0; site < m_num_sites; ++site)
+            addterm1_checked(g->e, site, dc->compute(site, alpha_label),
+                             m_labelingDataCosts[site]);
+        return;
+    }
+    // Only E(1), the cost of keeping the current label, has changed
+    for (SiteID i = 0; i < size; ++i) {
+        SiteID site = m_activeSites[i];
+        if (m_labelingDataCosts[site] > GCO_MAX_ENERGYTERM)
+            handleError("Data cost term was larger than GCO_MAX_ENERGYTERM; "
+                        "danger of integer overflow.");
+        g->e->update_term1(site, 0,
+                           m_labelingDataCosts[site] -
+                               dc->compute(site, g->labeling[site]));
+    }
+}
+
+//-----------------------------------------------------------------------------------
+
+template <typename SmoothCostT>
+void GCoptimization::setupSmoothCostsDynamic(LabelID       alpha_label,
+                                             DynamicGraph *g, SiteID size) {
+    SiteID          i, nSite, site, n, nNum, *nPointer;
+    EnergyTermType *weights;
+    SmoothCostT *   sc = (SmoothCostT *)m_smoothcostFn;
+    EnergyT *       e  = g->e;
+
+    if (size < 0) {
+        // Edges are added in the order dynamicEdge() relies on
+        for (site = 0; site < m_num_sites; site++) {
+            giveNeighborInfo(site, &nNum, &nPointer, &weights);
+            for (n = 0; n < nNum; n++) {
+                nSite = nPointer[n];
+                if (nSite < site)
+                    addterm2_checked(
+                        e, site, nSite,
+                        sc->compute(site, nSite, alpha_label, alpha_label),
+                        sc->compute(site, nSite, alpha_label,
+                                    m_labeling[nSite]),
+                        sc->compute(site, nSite, m_labeling[site],
+                                    alpha_label),
+                        sc->compute(site, nSite, m_labeling[site],
+                                    m_labeling[nSite]),
+                        weights[n]);
+            }
+        }
+        return;
+    }
+
+    LabelID *       old  = g->labeling;
+    EnergyT::arc_id arcs = e->get_first_arc();
+    for (i = 0; i < size; i++) {
+        site = m_activeSites[i];
+        giveNeighborInfo(site, &nNum, &nPointer, &weights);
+        for (n = 0; n < nNum; n++) {
+            nSite = nPointer[n];
+            // An edge between two changed sites is updated only once
+            if (nSite < site && old[nSite] != m_labeling[nSite])
+                continue;
+            SiteID  x  = site > nSite ? site : nSite;
+            SiteID  y  = site > nSite ? nSite : site;
+            LabelID lx = m_labeling[x], ly = m_labeling[y];
+            LabelID ox = old[x], oy = old[y];
+            EnergyTermType w = weights[n];
+            if (w > GCO_MAX_ENERGYTERM)
+                handleError("Smoothness weight was larger than "
+                            "GCO_MAX_ENERGYTERM; danger of integer "
+                            "overflow.");
+            EnergyTermType e01 = sc->compute(x, y, alpha_label, ly);
+            EnergyTermType e10 = sc->compute(x, y, lx, alpha_label);
+            EnergyTermType e11 = sc->compute(x, y, lx, ly);
+            if (e01 > GCO_MAX_ENERGYTERM || e10 > GCO_MAX_ENERGYTERM ||
+                e11 > GCO_MAX_ENERGYTERM)
+                handleError("Smooth cost term was larger than "
+                            "GCO_MAX_ENERGYTERM; danger of integer "
+                            "overflow.");
+            if (sc->compute(x, y, alpha_label, alpha_label) + e11 >
+                e01 + e10)
+                handleError("Non-submodular expansion term detected; smooth "
+                            "costs must be a metric for expansion");
+            e->update_term2(
+                x, y, arcs + 2 * dynamicEdge(x, y), 0,
+                (e01 - sc->compute(x, y, alpha_label, oy)) * w,
+                (e10 - sc->compute(x, y, ox, alpha_label)) * w,
+                (e11 - sc->compute(x, y, ox, oy)) * w);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------------
+
+template <typename DataCostT>
+void GCoptimization::applyDynamicLabeling(EnergyT *e, LabelID alpha_label) {
+    DataCostT *dc = (DataCostT *)m_datacostFn;
+    for (SiteID site = 0; site < m_num_sites; site++) {
+        if (e->get_var(site) == 0 && m_labeling[site] != alpha_label) {
+            m_labelCounts[alpha_label]++;
+            m_labelCounts[m_labeling[site]]--;
+            m_labeling[site]          = alpha_label;
+            m_labelingDataCosts[site] = dc->compute(site, alpha_label);
+        }
+    }
+    m_labelingInfoDirty = true;
+    updateLabelingInfo(
+        false, true,
+        false); // labels have changed, so update necessary labeling info
+}
+
+//-----------------------------------------------------------------------------------
+
+template <typename DataCostT>
+void GCoptimization::setupDataCostsGrid(SiteID size, LabelID alpha_label,
+                                        GridEnergyT *e,
+                                        SiteID *     activeSites) {
+    DataCostT *dc = (DataCostT *)m_datacostFn;
+    for (SiteID i = 0; i < size; i++) {
+        SiteID site = activeSites[i];
+        addterm1_checked(e, site, dc->compute(site, alpha_label),
+                         m_labelingDataCosts[site]);
+    }
+}
+
+//-----------------------------------------------------------------------------------
+
+template <typename SmoothCostT>
+void GCoptimization::setupSmoothCostsGrid(SiteID size, LabelID alpha_label,
+                                          GridEnergyT *e,
+                                          SiteID *     activeSites) {
+    SmoothCostT *sc = (SmoothCostT *)m_smoothcostFn;
+
+    // Only pairs with an active site get terms.  Every pair is visited once:
+    // from its left or upper site, unless that one is inactive.
+    for (SiteID i = 0; i < size; i++) {
+        SiteID site = activeSites[i];
+        SiteID x    = site % m_gridWidth;
+        SiteID y    = site / m_gridWidth;
+        if (x > 0 && m_lookupSiteVar[site - 1] == -1)
+            addGridPair(sc, e, site - 1, site,
+                        m_gridWeights ? m_gridWeights[2 * (site - 1)] : 1,
+                        alpha_label);
+        if (x + 1 < m_gridWidth)
+            addGridPair(sc, e, site, site + 1,
+                        m_gridWeights ? m_gridWeights[2 * site] : 1,
+                        alpha_label);
+        if (y > 0 && m_lookupSiteVar[site - m_gridWidth] == -1)
+            addGridPair(
+                sc, e, site - m_gridWidth, site,
+                m_gridWeights ? m_gridWeights[2 * (site - m_gridWidth) + 1]
+                              : 1,
+                alpha_label);
+        if (y + 1 < m_gridHeight)
+            addGridPair(sc, e, site, site + m_gridWidth,
+                        m_gridWeights ? m_gridWeights[2 * site + 1] : 1,
+                        alpha_label);
+    }
+}
+
+//-----------------------------------------------------------------------------------
+// Adds the terms setupSmoothCostsExpansion() adds for the pair s < t
+//
+template <typename SmoothCostT>
+OLGA_INLINE void GCoptimization::addGridPair(SmoothCostT *sc, GridEnergyT *e,
+                                             SiteID s, SiteID t,
+                                             EnergyTermType w,
+                                             LabelID        alpha_label) {
+    LabelID ls = m_labeling[s], lt = m_labeling[t];
+    bool    sActive = m_lookupSiteVar[s] != -1;
+    bool    tActive = m_lookupSiteVar[t] != -1;
+
+    if (sActive && tActive)
+        addterm2_checked(e, t, s, sc->compute(t, s, alpha_label, alpha_label),
+                         sc->compute(t, s, alpha_label, ls),
+                         sc->compute(t, s, lt, alpha_label),
+                         sc->compute(t, s, lt, ls), w);
+    else if (sActive)
+        addterm1_checked(e, s, sc->compute(s, t, alpha_label, lt),
+                         sc->compute(s, t, ls, lt), w);
+    else if (tActive)
+        addterm1_checked(e, t, sc->compute(t, s, alpha_label, ls),
+                         sc->compute(t, s, lt, ls), w);
+}
+
+//-----------------------------------------------------------------------------------
+
+template <typename DataCostT>
+void GCoptimization::applyGridLabeling(GridEnergyT *e, SiteID *activeSites,
+                                       SiteID size, LabelID alpha_label) {
+    DataCostT *dc = (DataCostT *)m_datacostFn;
+    for (SiteID i = 0; i < size; i++) {
+        SiteID site = activeSites[i];
+        if (e->get_var(site) == 0) {
+            LabelID prev     = m_labeling[site];
+            m_labeling[site] = alpha_label;
+            m_labelCounts[alpha_label]++;
+            m_labelCounts[prev]--;
+            m_labelingDataCosts[site] = dc->compute(site, alpha_label);
+        }
+    }
+    m_labelingInfoDirty = true;
+    updateLabelingInfo(
+        false, true,
+        false); // labels have changed, so update necessary labeling info
+}
+
+//-----------------------------------------------------------------------------------
+
 template <typename DataCostT>
 bool GCoptimization::solveSpecialCases(EnergyType &energy) {
     finalizeNeighbors();
@@ -804,6 +1080,14 @@ void GCoptimization::setDataCostFunctor(DataCostFunctor *f) {
     m_applyNewLabeling = &GCoptimization::applyNewLabeling<DataCostFunctor>;
     m_updateLabelingDataCosts =
         &GCoptimization::updateLabelingDataCosts<DataCostFunctor>;
+    m_setupDataCostsDynamic =
+        &GCoptimization::setupDataCostsDynamic<DataCostFunctor>;
+    m_applyDynamicLabeling =
+        &GCoptimization::applyDynamicLabeling<DataCostFunctor>;
+    m_setupDataCostsGrid =
+        &GCoptimization::setupDataCostsGrid<DataCostFunctor>;
+    m_applyGridLabeling =
+        &GCoptimization::applyGridLabeling<DataCostFunctor>;
     m_solveSpecialCases = &GCoptimization::solveSpecialCases<DataCostFunctor>;
     m_labelingInfoDirty = true;
 }
@@ -860,6 +1144,20 @@ void GCoptimization::setSmoothCost(LabelID l1, LabelID l2, EnergyTermType e) {
 
 //-------------------------------------------------------------------
 
+void GCoptimization::setSmoothCost(const SmoothCostPotts &model) {
+    specializeSmoothCostFunctor(model);
+}
+
+void GCoptimization::setSmoothCost(const SmoothCostTruncatedLinear &model) {
+    specializeSmoothCostFunctor(model);
+}
+
+void GCoptimization::setSmoothCost(const SmoothCostTruncatedQuadratic &model) {
+    specializeSmoothCostFunctor(model);
+}
+
+//-------------------------------------------------------------------
+
 void GCoptimization::setSmoothCostFunctor(SmoothCostFunctor *f) {
     if (m_smoothcostFnDelete)
         m_smoothcostFnDelete(m_smoothcostFn);
@@ -875,6 +1173,10 @@ void GCoptimization::setSmoothCostFunctor(SmoothCostFunctor *f) {
         &GCoptimization::setupSmoothCostsExpansion<SmoothCostFunctor>;
     m_setupSmoothCostsSwap =
         &GCoptimization::setupSmoothCostsSwap<SmoothCostFunctor>;
+    m_setupSmoothCostsDynamic =
+        &GCoptimization::setupSmoothCostsDynamic<SmoothCostFunctor>;
+    m_setupSmoothCostsGrid =
+        &GCoptimization::setupSmoothCostsGrid<SmoothCostFunctor>;
 }
 
 //-------------------------------------------------------------------
@@ -1024,6 +1326,7 @@ GCoptimization::EnergyType GCoptimization::expansion(int max_num_iterations) {
             do {
                 gcoclock_t ticks0 = gcoclock();
                 m_stepsThisCycle  = 0;
+                m_cycle           = cycle;
 
                 // Make a pass over the unchecked labels in the current queue,
                 // i.e. m_labelTable[next..queueSize-1]
@@ -1069,6 +1372,7 @@ GCoptimization::EnergyType GCoptimization::expansion(int max_num_iterations) {
             for (int cycle = 1; cycle <= max_num_iterations; cycle++) {
                 gcoclock_t ticks0 = gcoclock();
                 old_energy        = new_energy;
+                m_cycle           = cycle;
                 new_energy        = oneExpansionIteration();
                 printStatus1(cycle, false, ticks0);
                 if (new_energy == old_energy)
@@ -1077,10 +1381,10 @@ GCoptimization::EnergyType GCoptimization::expansion(int max_num_iterations) {
             }
         }
     } catch (...) {
-        m_stepsThisCycle = m_stepsThisCycleTotal = 0;
+        m_stepsThisCycle = m_stepsThisCycleTotal = m_cycle = 0;
         throw;
     }
-    m_stepsThisCycle = m_stepsThisCycleTotal =
+    m_stepsThisCycle = m_stepsThisCycleTotal = m_cycle =
         0; // set so that alpha_expansion() knows it's no inside expansion()
            // if called externally
     return new_energy;
@@ -1248,61 +1552,243 @@ bool GCoptimization::alpha_expansion(LabelID alpha_label) {
                   // could have changed since last expansion
     updateLabelingInfo();
 
+    if (m_dynamicGraphs)
+        return dynamic_alpha_expansion(alpha_label, ticks0);
+
     // Determine list of active sites for this expansion move
     SiteID     size                 = 0;
-    SiteID *   activeSites          = new SiteID[m_num_sites];
+    SiteID *   activeSites          = m_activeSites;
     EnergyType afterExpansionEnergy = 0;
-    try {
-        // Get list of active sites based on alpha and current labeling
-        if (m_queryActiveSitesExpansion)
-            size = (this->*m_queryActiveSitesExpansion)(alpha_label,
-                                                        activeSites);
-        if (size == 0) // Nothing to do
-        {
-            delete[] activeSites;
-            printStatus2(alpha_label, -1, size, ticks0);
-            return false;
+    // Get list of active sites based on alpha and current labeling
+    if (m_queryActiveSitesExpansion)
+        size = (this->*m_queryActiveSitesExpansion)(alpha_label,
+                                                    activeSites);
+    if (size == 0) // Nothing to do
+    {
+        logMove((EnergyT *)0, alpha_label, -1, size, ticks0, ticks0, ticks0,
+                0);
+        printStatus2(alpha_label, -1, size, ticks0);
+        return false;
+    }
+
+    // Initialise reverse-lookup so that non-active neighbours can be
+    // identified while constructing the graph
+    for (SiteID i = 0; i < size; i++)
+        m_lookupSiteVar[activeSites[i]] = i;
+
+    // The grid graph still resets and initializes a node per site, so moves
+    // with few active sites are cheaper on a graph of their own.
+    if (m_gridWidth && !m_labelcostsAll && size >= m_num_sites / 4)
+        return grid_alpha_expansion(alpha_label, size, ticks0);
+
+    // Create binary variables for each remaining site, add the data
+    // costs, and compute the smooth costs between variables.
+    EnergyT *e = resetEnergy(
+        size + m_labelcostCount, // poor guess at number of pairwise
+                                 // terms needed :(
+        m_numNeighborsTotal +
+            (m_labelcostCount ? size + m_labelcostCount : 0));
+    e->add_variable(size);
+    m_beforeExpansionEnergy = 0;
+    if (m_setupDataCostsExpansion)
+        (this->*m_setupDataCostsExpansion)(size, alpha_label, e,
+                                           activeSites);
+    if (m_setupSmoothCostsExpansion)
+        (this->*m_setupSmoothCostsExpansion)(size, alpha_label, e,
+                                             activeSites);
+    EnergyType alphaCorrection =
+        setupLabelCostsExpansion(size, alpha_label, e, activeSites);
+    checkInterrupt();
+    gcoclock_t ticks1    = gcoclock();
+    afterExpansionEnergy = e->minimize() + alphaCorrection;
+    gcoclock_t ticks2    = gcoclock();
+    checkInterrupt();
+
+    bool applied = afterExpansionEnergy < m_beforeExpansionEnergy;
+    logMove(e, alpha_label, -1, size, ticks0, ticks1, ticks2,
+            applied ? afterExpansionEnergy - m_beforeExpansionEnergy : 0);
+    if (applied)
+        (this->*m_applyNewLabeling)(e, activeSites, size, alpha_label);
+
+    for (SiteID i = 0; i < size; i++)
+        m_lookupSiteVar[activeSites[i]] =
+            -1; // restore m_lookupSite to all -1s
+
+    printStatus2(alpha_label, -1, size, ticks0);
+    return afterExpansionEnergy < m_beforeExpansionEnergy;
+}
+
+//-------------------------------------------------------------------
+
+GCoptimization::EnergyT *GCoptimization::resetEnergy(int var_num_max,
+                                                     int edge_num_max) {
+    if (!m_energy)
+        m_energy = new EnergyT(var_num_max, edge_num_max, handleError);
+    else
+        m_energy->reset();
+    return m_energy;
+}
+
+//-------------------------------------------------------------------
+
+void GCoptimization::setDynamicExpansion(bool enable) {
+    if (!enable) {
+        deleteDynamicGraphs();
+        return;
+    }
+    if (m_dynamicGraphs)
+        return;
+    if (m_labelcostsAll)
+        handleError("Dynamic expansion does not support label costs.");
+    m_dynamicGraphs = new DynamicGraph[m_num_labels];
+    memset(m_dynamicGraphs, 0, m_num_labels * sizeof(DynamicGraph));
+}
+
+//-------------------------------------------------------------------
+
+void GCoptimization::deleteDynamicGraphs() {
+    if (m_dynamicGraphs) {
+        for (LabelID l = 0; l < m_num_labels; ++l) {
+            delete m_dynamicGraphs[l].e;
+            delete[] m_dynamicGraphs[l].labeling;
         }
+        delete[] m_dynamicGraphs;
+        m_dynamicGraphs = 0;
+    }
+    delete[] m_dynamicEdges;
+    m_dynamicEdges = 0;
+}
 
-        // Initialise reverse-lookup so that non-active neighbours can be
-        // identified while constructing the graph
-        for (SiteID i = 0; i < size; i++)
-            m_lookupSiteVar[activeSites[i]] = i;
-
-        // Create binary variables for each remaining site, add the data
-        // costs, and compute the smooth costs between variables.
-        EnergyT e(size + m_labelcostCount, // poor guess at number of pairwise
-                                           // terms needed :(
-                  m_numNeighborsTotal +
-                      (m_labelcostCount ? size + m_labelcostCount : 0),
-                  handleError);
-        e.add_variable(size);
-        m_beforeExpansionEnergy = 0;
-        if (m_setupDataCostsExpansion)
-            (this->*m_setupDataCostsExpansion)(size, alpha_label, &e,
-                                               activeSites);
-        if (m_setupSmoothCostsExpansion)
-            (this->*m_setupSmoothCostsExpansion)(size, alpha_label, &e,
-                                                 activeSites);
-        EnergyType alphaCorrection =
-            setupLabelCostsExpansion(size, alpha_label, &e, activeSites);
-        checkInterrupt();
-        afterExpansionEnergy = e.minimize() + alphaCorrection;
-        checkInterrupt();
-
-        if (afterExpansionEnergy < m_beforeExpansionEnergy)
-            (this->*m_applyNewLabeling)(&e, activeSites, size, alpha_label);
+//-------------------------------------------------------------------
 
-        for (SiteID i = 0; i < size; i++)
-            m_lookupSiteVar[activeSites[i]] =
-                -1; // restore m_lookupSite to all -1s
+GCoptimization::SiteID GCoptimization::dynamicEdge(SiteID x, SiteID y) {
+    SiteID          nNum, *nPointer;
+    EnergyTermType *weights;
+    giveNeighborInfo(x, &nNum, &nPointer, &weights);
+    SiteID edge = m_dynamicEdges[x];
+    for (SiteID n = 0; nPointer[n] != y; n++)
+        if (nPointer[n] < x)
+            edge++;
+    return edge;
+}
 
-        printStatus2(alpha_label, -1, size, ticks0);
-    } catch (...) {
-        delete[] activeSites;
-        throw;
+//-------------------------------------------------------------------
+// Expansion move on a graph that is kept across moves: the terms of the
+// sites that changed their labels since the previous move on alpha_label
+// are updated, and the search trees of that move are reused.
+//
+bool GCoptimization::dynamic_alpha_expansion(LabelID    alpha_label,
+                                             gcoclock_t ticks0) {
+    if (m_labelcostsAll)
+        handleError("Dynamic expansion does not support label costs.");
+
+    if (!m_dynamicEdges) {
+        SiteID          nNum, *nPointer;
+        EnergyTermType *weights;
+        m_dynamicEdges = new SiteID[m_num_sites];
+        SiteID edges   = 0;
+        for (SiteID site = 0; site < m_num_sites; site++) {
+            m_dynamicEdges[site] = edges;
+            giveNeighborInfo(site, &nNum, &nPointer, &weights);
+            for (SiteID n = 0; n < nNum; n++)
+                if (nPointer[n] < site)
+                    edges++;
+        }
+    }
+
+    // Every site is a variable, sites labeled alpha_label cost the same
+    // either way
+    DynamicGraph *g     = m_dynamicGraphs + alpha_label;
+    bool          reuse = g->e != 0;
+    SiteID        size  = -1;
+    if (!reuse) {
+        g->e = new EnergyT(m_num_sites, m_numNeighborsTotal / 2, handleError);
+        g->labeling = new LabelID[m_num_sites];
+        g->e->add_variable(m_num_sites);
+    } else {
+        size = 0;
+        for (SiteID site = 0; site < m_num_sites; site++)
+            if (g->labeling[site] != m_labeling[site])
+                m_activeSites[size++] = site;
+    }
+
+    m_beforeExpansionEnergy = 0;
+    if (m_setupDataCostsDynamic)
+        (this->*m_setupDataCostsDynamic)(alpha_label, g, size);
+    if (m_setupSmoothCostsDynamic)
+        (this->*m_setupSmoothCostsDynamic)(alpha_label, g, size);
+    if (reuse) {
+        for (SiteID i = 0; i < size; i++)
+            g->labeling[m_activeSites[i]] = m_labeling[m_activeSites[i]];
+    } else
+        memcpy(g->labeling, m_labeling, m_num_sites * sizeof(LabelID));
+    checkInterrupt();
+    gcoclock_t ticks1               = gcoclock();
+    EnergyType afterExpansionEnergy = g->e->minimize(reuse);
+    gcoclock_t ticks2               = gcoclock();
+    checkInterrupt();
+
+    // The current labeling has every variable at 1, which only cuts the
+    // residual capacities from the source
+    m_beforeExpansionEnergy = afterExpansionEnergy;
+    for (SiteID site = 0; site < m_num_sites; site++) {
+        EnergyTermType r = g->e->get_trcap(site);
+        if (r > 0)
+            m_beforeExpansionEnergy += r;
     }
-    delete[] activeSites;
+
+    bool applied = afterExpansionEnergy < m_beforeExpansionEnergy;
+    logMove(g->e, alpha_label, -1, reuse ? size : m_num_sites, ticks0, ticks1,
+            ticks2,
+            applied ? afterExpansionEnergy - m_beforeExpansionEnergy : 0);
+    if (applied)
+        (this->*m_applyDynamicLabeling)(g->e, alpha_label);
+
+    printStatus2(alpha_label, -1, reuse ? size : m_num_sites, ticks0);
+    return afterExpansionEnergy < m_beforeExpansionEnergy;
+}
+
+//-------------------------------------------------------------------
+// Expansion move of a grid: every site has a variable, but only the active
+// sites get terms, so that the others stay out of the search trees and keep
+// their labels.
+//
+bool GCoptimization::grid_alpha_expansion(LabelID    alpha_label,
+                                          SiteID     size,
+                                          gcoclock_t ticks0) {
+    SiteID *activeSites = m_activeSites;
+
+    if (!m_gridEnergy) {
+        m_gridEnergy =
+            new GridEnergyT(m_gridWidth, m_gridHeight, handleError);
+    } else
+        m_gridEnergy->reset();
+    GridEnergyT *e = m_gridEnergy;
+    e->set_algorithm(m_gridAlgorithm);
+    e->add_variable(m_num_sites);
+
+    m_beforeExpansionEnergy = 0;
+    if (m_setupDataCostsGrid)
+        (this->*m_setupDataCostsGrid)(size, alpha_label, e, activeSites);
+    if (m_setupSmoothCostsGrid)
+        (this->*m_setupSmoothCostsGrid)(size, alpha_label, e, activeSites);
+    checkInterrupt();
+    gcoclock_t ticks1               = gcoclock();
+    EnergyType afterExpansionEnergy = e->minimize();
+    gcoclock_t ticks2               = gcoclock();
+    checkInterrupt();
+
+    bool applied = afterExpansionEnergy < m_beforeExpansionEnergy;
+    logMove(e, alpha_label, -1, size, ticks0, ticks1, ticks2,
+            applied ? afterExpansionEnergy - m_beforeExpansionEnergy : 0);
+    if (applied)
+        (this->*m_applyGridLabeling)(e, activeSites, size, alpha_label);
+
+    for (SiteID i = 0; i < size; i++)
+        m_lookupSiteVar[activeSites[i]] =
+            -1; // restore m_lookupSite to all -1s
+
+    printStatus2(alpha_label, -1, size, ticks0);
     return afterExpansionEnergy < m_beforeExpansionEnergy;
 }
 
@@ -1341,15 +1827,16 @@ GCoptimization::EnergyType GCoptimization::swap(int max_num_iterations) {
         while (old_energy > new_energy && curr_cycle <= max_num_iterations) {
             gcoclock_t ticks0 = gcoclock();
             old_energy        = new_energy;
+            m_cycle           = curr_cycle;
             new_energy        = oneSwapIteration();
             printStatus1(curr_cycle, true, ticks0);
             curr_cycle++;
         }
     } catch (...) {
-        m_stepsThisCycle = m_stepsThisCycleTotal = 0;
+        m_stepsThisCycle = m_stepsThisCycleTotal = m_cycle = 0;
         throw;
     }
-    m_stepsThisCycle = m_stepsThisCycleTotal = 0;
+    m_stepsThisCycle = m_stepsThisCycleTotal = m_cycle = 0;
 
     return (new_energy);
 }
@@ -1385,49 +1872,50 @@ void GCoptimization::alpha_beta_swap(LabelID alpha_label,
 
     // Determine the list of active sites for this swap move
     SiteID  size        = 0;
-    SiteID *activeSites = new SiteID[m_num_sites];
-    try {
-        for (SiteID i = 0; i < m_num_sites; i++) {
-            if (m_labeling[i] == alpha_label || m_labeling[i] == beta_label) {
-                activeSites[size]  = i;
-                m_lookupSiteVar[i] = size;
-                size++;
-            }
-        }
-        if (size == 0) {
-            delete[] activeSites;
-            printStatus2(alpha_label, beta_label, size, ticks0);
-            return;
+    SiteID *activeSites = m_activeSites;
+    for (SiteID i = 0; i < m_num_sites; i++) {
+        if (m_labeling[i] == alpha_label || m_labeling[i] == beta_label) {
+            activeSites[size]  = i;
+            m_lookupSiteVar[i] = size;
+            size++;
         }
+    }
+    if (size == 0) {
+        logMove((EnergyT *)0, alpha_label, beta_label, size, ticks0, ticks0,
+                ticks0, 0);
+        printStatus2(alpha_label, beta_label, size, ticks0);
+        return;
+    }
+    EnergyType energy0 = m_moveLogEnabled ? compute_energy() : 0;
+
+    // Create binary variables for each remaining site, add the data
+    // costs, and compute the smooth costs between variables.
+    EnergyT *e = resetEnergy(size, m_numNeighborsTotal);
+    e->add_variable(size);
+    if (m_setupDataCostsSwap)
+        (this->*m_setupDataCostsSwap)(size, alpha_label, beta_label, e,
+                                      activeSites);
+    if (m_setupSmoothCostsSwap)
+        (this->*m_setupSmoothCostsSwap)(size, alpha_label, beta_label, e,
+                                        activeSites);
+    checkInterrupt();
+    gcoclock_t ticks1 = gcoclock();
+    e->minimize();
+    gcoclock_t ticks2 = gcoclock();
+    checkInterrupt();
 
-        // Create binary variables for each remaining site, add the data
-        // costs, and compute the smooth costs between variables.
-        EnergyT e(size, m_numNeighborsTotal, handleError);
-        e.add_variable(size);
-        if (m_setupDataCostsSwap)
-            (this->*m_setupDataCostsSwap)(size, alpha_label, beta_label, &e,
-                                          activeSites);
-        if (m_setupSmoothCostsSwap)
-            (this->*m_setupSmoothCostsSwap)(size, alpha_label, beta_label, &e,
-                                            activeSites);
-        checkInterrupt();
-        e.minimize();
-        checkInterrupt();
-
-        // Apply the new labeling
-        for (SiteID i = 0; i < size; i++) {
-            m_labeling[activeSites[i]] =
-                (e.get_var(i) == 0) ? alpha_label : beta_label;
-            m_lookupSiteVar[activeSites[i]] =
-                -1; // restore lookupSiteVar to all -1s
-        }
-        m_labelingInfoDirty = true;
-    } catch (...) {
-        delete[] activeSites;
-        throw;
+    // Apply the new labeling
+    for (SiteID i = 0; i < size; i++) {
+        m_labeling[activeSites[i]] =
+            (e->get_var(i) == 0) ? alpha_label : beta_label;
+        m_lookupSiteVar[activeSites[i]] =
+            -1; // restore lookupSiteVar to all -1s
     }
-    delete[] activeSites;
+    m_labelingInfoDirty = true;
 
+    if (m_moveLogEnabled)
+        logMove(e, alpha_label, beta_label, size, ticks0, ticks1, ticks2,
+                compute_energy() - energy0);
     printStatus2(alpha_label, beta_label, size, ticks0);
 }
 
@@ -1447,6 +1935,10 @@ GCoptimizationGridGraph::GCoptimizationGridGraph(SiteID width, SiteID height,
     m_width  = width;
     m_height = height;
 
+    // Expansion moves use the grid directly, see grid_alpha_expansion()
+    m_gridWidth  = width;
+    m_gridHeight = height;
+
     m_numNeighbors = new SiteID[m_num_sites];
     m_neighbors    = new SiteID[4 * m_num_sites];
 
@@ -1482,8 +1974,10 @@ GCoptimizationGridGraph::~GCoptimizationGridGraph() {
     delete[] m_numNeighbors;
     if (m_neighbors)
         delete[] m_neighbors;
-    if (m_weightedGraph)
+    if (m_weightedGraph) {
         delete[] m_neighborsWeights;
+        delete[] m_gridWeights;
+    }
 }
 
 //-------------------------------------------------------------------
@@ -1542,6 +2036,7 @@ void GCoptimizationGridGraph::computeNeighborWeights(EnergyTermType *vCosts,
     GCoptimization::EnergyTermType weight;
 
     m_neighborsWeights = new EnergyTermType[m_num_sites * 4];
+    m_gridWeights      = new EnergyTermType[m_num_sites * 2];
 
     for (i = 0; i < m_num_sites; i++) {
         for (n = 0; n < m_numNeighbors[i]; n++) {
@@ -1557,6 +2052,8 @@ void GCoptimizationGridGraph::computeNeighborWeights(EnergyTermType *vCosts,
 
             m_neighborsWeights[i * 4 + n] = weight;
         }
+        m_gridWeights[2 * i]     = hCosts[i];
+        m_gridWeights[2 * i + 1] = vCosts[i];
     }
 }
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1775,6 +2272,70 @@ void GCoptimization::printStatus2(int alpha, int beta, int numVars,
     flushnow();
 }
 
+//------------------------------------------------------------------
+// move log
+
+void GCoptimization::setMoveLog(bool enable) {
+    if (enable)
+        m_moveLog.clear();
+    m_moveLogEnabled = enable;
+}
+
+template <typename E>
+void GCoptimization::logMove(E *e, LabelID alpha, LabelID beta, SiteID sites,
+                             gcoclock_t ticks0, gcoclock_t ticks1,
+                             gcoclock_t ticks2, EnergyType delta) {
+    if (!m_moveLogEnabled)
+        return;
+    MoveInfo info;
+    info.cycle     = m_cycle;
+    info.alpha     = alpha;
+    info.beta      = beta;
+    info.sites     = sites;
+    info.nodes     = e ? e->get_node_num() : 0;
+    info.edges     = e ? e->get_arc_num() / 2 : 0;
+    info.bytes     = e ? e->get_memory() : 0;
+    info.setupMs   = 1000.0 * (ticks1 - ticks0) / GCO_CLOCKS_PER_SEC;
+    info.maxflowMs = 1000.0 * (ticks2 - ticks1) / GCO_CLOCKS_PER_SEC;
+    info.delta     = delta;
+    m_moveLog.push_back(info);
+}
+
+void GCoptimization::writeMoveLog(const char *filename) {
+    size_t len  = strlen(filename);
+    bool   json = len >= 5 && strcmp(filename + len - 5, ".json") == 0;
+    FILE * f    = fopen(filename, "w");
+    if (!f)
+        handleError("Cannot open the move log for writing.");
+
+    if (!json)
+        fprintf(f, "cycle,alpha,beta,sites,nodes,edges,bytes,setup_ms,"
+                   "maxflow_ms,delta\n");
+    else
+        fprintf(f, "[");
+    for (size_t i = 0; i < m_moveLog.size(); i++) {
+        const MoveInfo &m = m_moveLog[i];
+        char beta[16]     = "";
+        if (m.beta >= 0)
+            sprintf(beta, "%d", m.beta + INDEX0);
+        else if (json)
+            strcpy(beta, "null");
+        fprintf(f,
+                json ? "%s\n  {\"cycle\": %d, \"alpha\": %d, \"beta\": %s, "
+                       "\"sites\": %lld, \"nodes\": %d, \"edges\": %d, "
+                       "\"bytes\": %llu, \"setup_ms\": %.3f, "
+                       "\"maxflow_ms\": %.3f, \"delta\": %lld}"
+                     : "%s%d,%d,%s,%lld,%d,%d,%llu,%.3f,%.3f,%lld\n",
+                json && i ? "," : "", m.cycle, m.alpha + INDEX0, beta,
+                (long long)m.sites, m.nodes, m.edges,
+                (unsigned long long)m.bytes, m.setupMs, m.maxflowMs,
+                (long long)m.delta);
+    }
+    if (json)
+        fprintf(f, "\n]\n");
+    fclose(f);
+}
+
 //-------------------------------------------------------------------
 // DataCostFnSparse methods
 //-------------------------------------------------------------------
@@ -109,10 +109,15 @@ publications and we use his implementation here with permission.
 #error Requires Visual C++ 2005 (VC8) compiler or later.
 #endif
 
+#include "compactgraph.h"
 #include "energy.h"
+#include "gridgraph.h"
+#include "compactgraph.cpp"
 #include "graph.cpp"
+#include "gridgraph.cpp"
 #include "maxflow.cpp"
 #include <cstddef>
+#include <vector>
 
 /////////////////////////////////////////////////////////////////////
 // Utility functions, classes, and macros
@@ -175,7 +180,16 @@ class GCoptimization {
 #endif
     typedef int EnergyTermType; // 32-bit energy terms
 #endif
+#ifdef GCO_COMPACT_GRAPH
+    // Index based graph with about half the memory, see compactgraph.h
+    typedef Energy<EnergyTermType, EnergyTermType, EnergyType, CompactGraph>
+        EnergyT;
+#else
     typedef Energy<EnergyTermType, EnergyTermType, EnergyType> EnergyT;
+#endif
+    // Expansion moves of GCoptimizationGridGraph, see gridgraph.h
+    typedef Energy<EnergyTermType, EnergyTermType, EnergyType, GridGraph>
+        GridEnergyT;
     typedef EnergyT::Var                                       VarID;
     typedef int   LabelID; // Type for labels
     typedef VarID SiteID;  // Type for sites
@@ -250,6 +264,52 @@ class GCoptimization {
                                        LabelID l2) = 0;
     };
 
+    // Common smooth cost models.  They are compiled into the setup of every
+    // move like the built-in functors below, instead of being looked up in
+    // an m_num_labels^2 table or called through a virtual function.
+    //   SmoothCostPotts(w):                 w if l1 != l2, 0 otherwise
+    //   SmoothCostTruncatedLinear(w, t):    w * min(|l1 - l2|, t)
+    //   SmoothCostTruncatedQuadratic(w, t): w * min((l1 - l2)^2, t)
+    // The truncated quadratic model is not a metric, so it only works with
+    // swap moves.
+    struct SmoothCostPotts {
+        explicit SmoothCostPotts(EnergyTermType w = 1) : m_w(w) {}
+        OLGA_INLINE EnergyTermType compute(SiteID, SiteID, LabelID l1,
+                                           LabelID l2) {
+            return l1 != l2 ? m_w : (EnergyTermType)0;
+        }
+
+      private:
+        EnergyTermType m_w;
+    };
+    struct SmoothCostTruncatedLinear {
+        SmoothCostTruncatedLinear(EnergyTermType w, EnergyTermType t)
+            : m_w(w), m_t(t) {}
+        OLGA_INLINE EnergyTermType compute(SiteID, SiteID, LabelID l1,
+                                           LabelID l2) {
+            EnergyTermType d = l1 < l2 ? l2 - l1 : l1 - l2;
+            return m_w * (d < m_t ? d : m_t);
+        }
+
+      private:
+        EnergyTermType m_w, m_t;
+    };
+    struct SmoothCostTruncatedQuadratic {
+        SmoothCostTruncatedQuadratic(EnergyTermType w, EnergyTermType t)
+            : m_w(w), m_t(t) {}
+        OLGA_INLINE EnergyTermType compute(SiteID, SiteID, LabelID l1,
+                                           LabelID l2) {
+            EnergyTermType d = (l1 - l2) * (l1 - l2);
+            return m_w * (d < m_t ? d : m_t);
+        }
+
+      private:
+        EnergyTermType m_w, m_t;
+    };
+    void setSmoothCost(const SmoothCostPotts &model);
+    void setSmoothCost(const SmoothCostTruncatedLinear &model);
+    void setSmoothCost(const SmoothCostTruncatedQuadratic &model);
+
     // Sets the cost of using label in the solution.
     // Set either as uniform cost, or an individual per-label cost.
     void setLabelCost(EnergyTermType cost);
@@ -291,6 +351,46 @@ class GCoptimization {
     //   2 => expansion-/swap-level output (label(s), current energy)
     void setVerbosity(int level) { m_verbosity = level; }
 
+    // setDynamicExpansion(true) keeps the graph of every label across
+    // expansion moves: a move only updates the terms of the sites whose
+    // labels changed since the previous move on the same label, and maxflow
+    // reuses its search trees.  Memory grows with the number of labels
+    // times the number of sites.  Data and smooth costs must not change
+    // while it is enabled, label costs are not supported.
+    // setDynamicExpansion(false) frees the graphs.
+    void setDynamicExpansion(bool enable);
+
+    // Maxflow algorithm of the expansion moves of GCoptimizationGridGraph,
+    // GridEnergyT::BOYKOV_KOLMOGOROV by default.  GridEnergyT::PUSH_RELABEL
+    // runs the pushes of every move in parallel (see gridgraph.h), which
+    // pays off on large grids when the caller does not already use all
+    // threads.  Other graphs, swap moves and label costs always use BK.
+    void setMaxflowAlgorithm(GridEnergyT::algotype algorithm) {
+        m_gridAlgorithm = algorithm;
+    }
+
+    // What a move did and cost, recorded while the move log is enabled
+    struct MoveInfo {
+        int        cycle;     // cycle of expansion() or swap(), 0 outside
+        LabelID    alpha;     // expansion label, or the labels of a swap
+        LabelID    beta;      // -1 for expansion moves
+        SiteID     sites;     // number of active sites
+        int        nodes;     // size of the binary graph, 0 if there was
+        int        edges;     // nothing to do
+        size_t     bytes;     // memory held by the graph
+        double     setupMs;   // time to set up the graph
+        double     maxflowMs; // time to minimize it
+        EnergyType delta;     // change of the energy, 0 if rejected
+    };
+    // setMoveLog(true) clears the log and records every following move,
+    // setMoveLog(false) stops recording.  Swap moves evaluate the energy
+    // before and after with compute_energy() while recording, which slows
+    // them down like verbosity 2 does.
+    void                          setMoveLog(bool enable);
+    const std::vector<MoveInfo> &moveLog() const { return m_moveLog; }
+    // Writes the move log as CSV, or as JSON if filename ends with ".json"
+    void writeMoveLog(const char *filename);
+
   protected:
     struct LabelCost {
         ~LabelCost() { delete[] labels; }
@@ -315,6 +415,24 @@ class GCoptimization {
     SiteID * m_lookupSiteVar; // holds index of variable corresponding to site
                              // participating in a move, -1 for
                              // nonparticipating site
+    SiteID * m_activeSites; // sites participating in the current move
+    EnergyT *m_energy; // graph of the current move, kept across moves so
+                       // that its nodes and arcs are allocated only once
+    struct DynamicGraph {
+        EnergyT *e;        // one variable per site, one edge per neighbor
+                           // pair, created on the first move of the label
+        LabelID *labeling; // labeling the terms of e were set up for
+    };
+    DynamicGraph *m_dynamicGraphs; // per label, 0 unless dynamic expansion
+    SiteID *      m_dynamicEdges;  // index of the first edge of each site
+                                   // in the graphs above
+    SiteID          m_gridWidth;   // size of the grid set by
+    SiteID          m_gridHeight;  // GCoptimizationGridGraph, 0 otherwise
+    EnergyTermType *m_gridWeights; // weights of the right and down neighbor
+                                   // of each site, 0 for unit weights
+    GridEnergyT *   m_gridEnergy;  // one variable per site, kept across
+                                   // moves like m_energy
+    GridEnergyT::algotype m_gridAlgorithm; // maxflow of m_gridEnergy
     LabelID *m_labelTable; // to figure out label order in which to do
                            // expansion/swaps
     int             m_stepsThisCycle;
@@ -330,6 +448,9 @@ class GCoptimization {
     int             m_labelcostCount;
     bool            m_labelingInfoDirty;
     int             m_verbosity;
+    bool            m_moveLogEnabled;
+    std::vector<MoveInfo> m_moveLog;
+    int                   m_cycle; // current cycle for the move log
 
     void *     m_datacostFn;
     void *     m_smoothcostFn;
@@ -351,6 +472,17 @@ class GCoptimization {
     void (GCoptimization::*m_applyNewLabeling)(EnergyT *, SiteID *, SiteID,
                                                LabelID);
     void (GCoptimization::*m_updateLabelingDataCosts)();
+    void (GCoptimization::*m_setupDataCostsDynamic)(LabelID, DynamicGraph *,
+                                                    SiteID);
+    void (GCoptimization::*m_setupSmoothCostsDynamic)(LabelID,
+                                                      DynamicGraph *, SiteID);
+    void (GCoptimization::*m_applyDynamicLabeling)(EnergyT *, LabelID);
+    void (GCoptimization::*m_setupDataCostsGrid)(SiteID, LabelID,
+                                                 GridEnergyT *, SiteID *);
+    void (GCoptimization::*m_setupSmoothCostsGrid)(SiteID, LabelID,
+                                                   GridEnergyT *, SiteID *);
+    void (GCoptimization::*m_applyGridLabeling)(GridEnergyT *, SiteID *,
+                                                SiteID, LabelID);
 
     void (*m_datacostFnDelete)(void *f);
     void (*m_smoothcostFnDelete)(void *f);
@@ -539,6 +671,31 @@ class GCoptimization {
     void applyNewLabeling(EnergyT *e, SiteID *activeSites, SiteID size,
                           LabelID alpha_label);
     template <typename DataCostT> void updateLabelingDataCosts();
+    // Set up the terms of a dynamic graph for alpha_label from scratch if
+    // size < 0, or else update the terms of the size sites listed in
+    // m_activeSites, whose labels differ from g->labeling
+    template <typename DataCostT>
+    void setupDataCostsDynamic(LabelID alpha_label, DynamicGraph *g,
+                               SiteID size);
+    template <typename SmoothCostT>
+    void setupSmoothCostsDynamic(LabelID alpha_label, DynamicGraph *g,
+                                 SiteID size);
+    template <typename DataCostT>
+    void applyDynamicLabeling(EnergyT *e, LabelID alpha_label);
+    // Same as the expansion functions above on m_gridEnergy, where the
+    // variable of a site is the site itself
+    template <typename DataCostT>
+    void setupDataCostsGrid(SiteID size, LabelID alpha_label, GridEnergyT *e,
+                            SiteID *activeSites);
+    template <typename SmoothCostT>
+    void setupSmoothCostsGrid(SiteID size, LabelID alpha_label,
+                              GridEnergyT *e, SiteID *activeSites);
+    template <typename SmoothCostT>
+    void addGridPair(SmoothCostT *sc, GridEnergyT *e, SiteID s, SiteID t,
+                     EnergyTermType w, LabelID alpha_label);
+    template <typename DataCostT>
+    void applyGridLabeling(GridEnergyT *e, SiteID *activeSites, SiteID size,
+                           LabelID alpha_label);
     template <typename UserFunctor>
     void specializeDataCostFunctor(const UserFunctor f);
     template <typename UserFunctor>
@@ -550,13 +707,34 @@ class GCoptimization {
                                   bool updateActive = true,
                                   bool updateCosts  = true);
 
+    // Returns the persistent graph emptied for a new move, it is only
+    // allocated on the first move and grows as needed afterwards
+    EnergyT *resetEnergy(int var_num_max, int edge_num_max);
+
+    // Expansion move on the persistent graph of alpha_label, see
+    // setDynamicExpansion()
+    bool dynamic_alpha_expansion(LabelID alpha_label, gcoclock_t ticks0);
+    // Index of the edge between sites x > y in the dynamic graphs
+    SiteID dynamicEdge(SiteID x, SiteID y);
+    void   deleteDynamicGraphs();
+
+    // Expansion move on m_gridEnergy for the size sites in m_activeSites,
+    // whose neighbors are found from the grid instead of giveNeighborInfo().
+    // Used by grid graphs for moves with at least a quarter of the sites
+    // active.
+    bool grid_alpha_expansion(LabelID alpha_label, SiteID size,
+                              gcoclock_t ticks0);
+
     // Check for overflow and submodularity issues when setting up binary
     // graph cut
-    void addterm1_checked(EnergyT *e, VarID i, EnergyTermType e0,
+    template <typename E>
+    void addterm1_checked(E *e, VarID i, EnergyTermType e0,
                           EnergyTermType e1);
-    void addterm1_checked(EnergyT *e, VarID i, EnergyTermType e0,
+    template <typename E>
+    void addterm1_checked(E *e, VarID i, EnergyTermType e0,
                           EnergyTermType e1, EnergyTermType w);
-    void addterm2_checked(EnergyT *e, VarID i, VarID j, EnergyTermType e00,
+    template <typename E>
+    void addterm2_checked(E *e, VarID i, VarID j, EnergyTermType e00,
                           EnergyTermType e01, EnergyTermType e10,
                           EnergyTermType e11, EnergyTermType w);
 
@@ -577,6 +755,13 @@ class GCoptimization {
     void       printStatus1(const char *extraMsg = 0);
     void       printStatus1(int cycle, bool isSwap, gcoclock_t ticks0);
     void printStatus2(int alpha, int beta, int numVars, gcoclock_t ticks0);
+    // Appends a move to m_moveLog if enabled, e is 0 if the move had
+    // nothing to do.  The graph was set up between ticks0 and ticks1 and
+    // minimized between ticks1 and ticks2.
+    template <typename E>
+    void logMove(E *e, LabelID alpha, LabelID beta, SiteID sites,
+                 gcoclock_t ticks0, gcoclock_t ticks1, gcoclock_t ticks2,
+                 EnergyType delta);
 
     void permuteLabelTable();
 
@@ -0,0 +1,638 @@
+/* compactgraph.cpp */
+/*
+        Maxflow of CompactGraph, a line by line port of maxflow.cpp to
+        index based nodes and arcs.
+*/
+
+#include "compactgraph.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define INFINITE_D                                                           \
+    ((int)(((unsigned)-1) / 2)) /* infinite distance to the terminal */
+
+template <typename captype, typename tcaptype, typename flowtype>
+CompactGraph<captype, tcaptype, flowtype>::CompactGraph(
+    int node_num_max, int edge_num_max, void (*err_function)(const char *))
+    : first(NULL), tr_cap(NULL), parent(NULL), next(NULL), TS(NULL),
+      DIST(NULL), flags(NULL), arcs(NULL), node_num(0), node_max(0),
+      arc_num(0), arc_max(0), nodeptr_block(NULL),
+      error_function(err_function) {
+    if (node_num_max < 16)
+        node_num_max = 16;
+    if (edge_num_max < 16)
+        edge_num_max = 16;
+
+    allocate_nodes(node_num_max);
+    allocate_arcs(2 * edge_num_max);
+
+    maxflow_iteration = 0;
+    flow              = 0;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+CompactGraph<captype, tcaptype, flowtype>::~CompactGraph() {
+    if (nodeptr_block) {
+        delete nodeptr_block;
+        nodeptr_block = NULL;
+    }
+    free(first);
+    free(tr_cap);
+    free(parent);
+    free(next);
+    free(TS);
+    free(DIST);
+    free(flags);
+    free(arcs);
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::reset() {
+    node_num = 0;
+    arc_num  = 0;
+
+    if (nodeptr_block) {
+        delete nodeptr_block;
+        nodeptr_block = NULL;
+    }
+
+    maxflow_iteration = 0;
+    flow              = 0;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::error(const char *message) {
+    if (error_function)
+        (*error_function)(message);
+    exit(1);
+}
+
+/*
+        Nodes and arcs refer to each other by index, growing the arrays
+        does not need to patch any of them.
+*/
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::allocate_nodes(int num_max) {
+    first  = (arc_id *)realloc(first, num_max * sizeof(arc_id));
+    tr_cap = (tcaptype *)realloc(tr_cap, num_max * sizeof(tcaptype));
+    parent = (arc_id *)realloc(parent, num_max * sizeof(arc_id));
+    next   = (node_id *)realloc(next, num_max * sizeof(node_id));
+    TS     = (int *)realloc(TS, num_max * sizeof(int));
+    DIST   = (int *)realloc(DIST, num_max * sizeof(int));
+    flags  = (unsigned char *)realloc(flags, num_max);
+    if (!first || !tr_cap || !parent || !next || !TS || !DIST || !flags)
+        error("Not enough memory!");
+    node_max = num_max;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::allocate_arcs(int num_max) {
+    arcs = (arc *)realloc(arcs, num_max * sizeof(arc));
+    if (!arcs)
+        error("Not enough memory!");
+    arc_max = num_max;
+}
+
+/***********************************************************************/
+
+/*
+        Functions for processing active list, see maxflow.cpp.
+        next[i] is the next node in the list (or i, if i is the last node
+        in the list), and NONE iff i is not in the list.
+*/
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void
+CompactGraph<captype, tcaptype, flowtype>::set_active(node_id i) {
+    if (next[i] == NONE) {
+        /* it's not in the list yet */
+        if (queue_last[1] != NONE)
+            next[queue_last[1]] = i;
+        else
+            queue_first[1] = i;
+        queue_last[1] = i;
+        next[i]       = i;
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline typename CompactGraph<captype, tcaptype, flowtype>::node_id
+CompactGraph<captype, tcaptype, flowtype>::next_active() {
+    node_id i;
+
+    while (1) {
+        if ((i = queue_first[0]) == NONE) {
+            queue_first[0] = i = queue_first[1];
+            queue_last[0]      = queue_last[1];
+            queue_first[1]     = NONE;
+            queue_last[1]      = NONE;
+            if (i == NONE)
+                return NONE;
+        }
+
+        /* remove it from the active list */
+        if (next[i] == i)
+            queue_first[0] = queue_last[0] = NONE;
+        else
+            queue_first[0] = next[i];
+        next[i] = NONE;
+
+        /* a node in the list is active iff it has a parent */
+        if (parent[i] != NONE)
+            return i;
+    }
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void
+CompactGraph<captype, tcaptype, flowtype>::set_orphan_front(node_id i) {
+    nodeptr *np;
+    parent[i]    = ORPHAN_ARC;
+    np           = nodeptr_block->New();
+    np->ptr      = i;
+    np->next     = orphan_first;
+    orphan_first = np;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void
+CompactGraph<captype, tcaptype, flowtype>::set_orphan_rear(node_id i) {
+    nodeptr *np;
+    parent[i] = ORPHAN_ARC;
+    np        = nodeptr_block->New();
+    np->ptr   = i;
+    if (orphan_last)
+        orphan_last->next = np;
+    else
+        orphan_first = np;
+    orphan_last = np;
+    np->next    = NULL;
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void
+CompactGraph<captype, tcaptype, flowtype>::add_to_changed_list(node_id i) {
+    if (changed_list && !(flags[i] & IN_CHANGED_LIST)) {
+        *changed_list->New() = i;
+        flags[i] |= IN_CHANGED_LIST;
+    }
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::maxflow_init() {
+    node_id i;
+
+    queue_first[0] = queue_last[0] = NONE;
+    queue_first[1] = queue_last[1] = NONE;
+    orphan_first                   = NULL;
+
+    TIME = 0;
+
+    for (i = 0; i < node_num; i++) {
+        next[i] = NONE;
+        flags[i] &= ~(IS_MARKED | IN_CHANGED_LIST);
+        TS[i] = TIME;
+        if (tr_cap[i] > 0) {
+            /* i is connected to the source */
+            flags[i] &= ~IS_SINK;
+            parent[i] = TERMINAL_ARC;
+            set_active(i);
+            DIST[i] = 1;
+        } else if (tr_cap[i] < 0) {
+            /* i is connected to the sink */
+            flags[i] |= IS_SINK;
+            parent[i] = TERMINAL_ARC;
+            set_active(i);
+            DIST[i] = 1;
+        } else {
+            parent[i] = NONE;
+        }
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::maxflow_reuse_trees_init() {
+    node_id  i;
+    node_id  j;
+    node_id  queue = queue_first[1];
+    arc_id   a;
+    nodeptr *np;
+
+    queue_first[0] = queue_last[0] = NONE;
+    queue_first[1] = queue_last[1] = NONE;
+    orphan_first = orphan_last = NULL;
+
+    TIME++;
+
+    while ((i = queue) != NONE) {
+        queue = next[i];
+        if (queue == i)
+            queue = NONE;
+        next[i] = NONE;
+        flags[i] &= ~IS_MARKED;
+        set_active(i);
+
+        if (tr_cap[i] == 0) {
+            if (parent[i] != NONE)
+                set_orphan_rear(i);
+            continue;
+        }
+
+        if (tr_cap[i] > 0) {
+            if (parent[i] == NONE || is_sink(i)) {
+                flags[i] &= ~IS_SINK;
+                for (a = first[i]; a != NONE; a = arcs[a].next) {
+                    j = arcs[a].head;
+                    if (!(flags[j] & IS_MARKED)) {
+                        if (parent[j] == (a ^ 1))
+                            set_orphan_rear(j);
+                        if (parent[j] != NONE && is_sink(j) &&
+                            arcs[a].r_cap > 0)
+                            set_active(j);
+                    }
+                }
+                add_to_changed_list(i);
+            }
+        } else {
+            if (parent[i] == NONE || !is_sink(i)) {
+                flags[i] |= IS_SINK;
+                for (a = first[i]; a != NONE; a = arcs[a].next) {
+                    j = arcs[a].head;
+                    if (!(flags[j] & IS_MARKED)) {
+                        if (parent[j] == (a ^ 1))
+                            set_orphan_rear(j);
+                        if (parent[j] != NONE && !is_sink(j) &&
+                            arcs[a ^ 1].r_cap > 0)
+                            set_active(j);
+                    }
+                }
+                add_to_changed_list(i);
+            }
+        }
+        parent[i] = TERMINAL_ARC;
+        TS[i]     = TIME;
+        DIST[i]   = 1;
+    }
+
+    /* adoption */
+    while ((np = orphan_first)) {
+        orphan_first = np->next;
+        i            = np->ptr;
+        nodeptr_block->Delete(np);
+        if (!orphan_first)
+            orphan_last = NULL;
+        if (is_sink(i))
+            process_sink_orphan(i);
+        else
+            process_source_orphan(i);
+    }
+    /* adoption end */
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::augment(arc_id middle_arc) {
+    node_id  i;
+    arc_id   a;
+    tcaptype bottleneck;
+
+    /* 1. Finding bottleneck capacity */
+    /* 1a - the source tree */
+    bottleneck = arcs[middle_arc].r_cap;
+    for (i = arcs[middle_arc ^ 1].head;; i = arcs[a].head) {
+        a = parent[i];
+        if (a == TERMINAL_ARC)
+            break;
+        if (bottleneck > arcs[a ^ 1].r_cap)
+            bottleneck = arcs[a ^ 1].r_cap;
+    }
+    if (bottleneck > tr_cap[i])
+        bottleneck = tr_cap[i];
+    /* 1b - the sink tree */
+    for (i = arcs[middle_arc].head;; i = arcs[a].head) {
+        a = parent[i];
+        if (a == TERMINAL_ARC)
+            break;
+        if (bottleneck > arcs[a].r_cap)
+            bottleneck = arcs[a].r_cap;
+    }
+    if (bottleneck > -tr_cap[i])
+        bottleneck = -tr_cap[i];
+
+    /* 2. Augmenting */
+    /* 2a - the source tree */
+    arcs[middle_arc ^ 1].r_cap += bottleneck;
+    arcs[middle_arc].r_cap -= bottleneck;
+    for (i = arcs[middle_arc ^ 1].head;; i = arcs[a].head) {
+        a = parent[i];
+        if (a == TERMINAL_ARC)
+            break;
+        arcs[a].r_cap += bottleneck;
+        arcs[a ^ 1].r_cap -= bottleneck;
+        if (!arcs[a ^ 1].r_cap) {
+            set_orphan_front(
+                i); // add i to the beginning of the adoption list
+        }
+    }
+    tr_cap[i] -= bottleneck;
+    if (!tr_cap[i]) {
+        set_orphan_front(i); // add i to the beginning of the adoption list
+    }
+    /* 2b - the sink tree */
+    for (i = arcs[middle_arc].head;; i = arcs[a].head) {
+        a = parent[i];
+        if (a == TERMINAL_ARC)
+            break;
+        arcs[a ^ 1].r_cap += bottleneck;
+        arcs[a].r_cap -= bottleneck;
+        if (!arcs[a].r_cap) {
+            set_orphan_front(
+                i); // add i to the beginning of the adoption list
+        }
+    }
+    tr_cap[i] += bottleneck;
+    if (!tr_cap[i]) {
+        set_orphan_front(i); // add i to the beginning of the adoption list
+    }
+
+    flow += bottleneck;
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::process_source_orphan(
+    node_id i) {
+    node_id j;
+    arc_id  a0, a0_min = NONE, a;
+    int     d, d_min   = INFINITE_D;
+
+    /* trying to find a new parent */
+    for (a0 = first[i]; a0 != NONE; a0 = arcs[a0].next)
+        if (arcs[a0 ^ 1].r_cap) {
+            j = arcs[a0].head;
+            if (!is_sink(j) && (a = parent[j]) != NONE) {
+                /* checking the origin of j */
+                d = 0;
+                while (1) {
+                    if (TS[j] == TIME) {
+                        d += DIST[j];
+                        break;
+                    }
+                    a = parent[j];
+                    d++;
+                    if (a == TERMINAL_ARC) {
+                        TS[j]   = TIME;
+                        DIST[j] = 1;
+                        break;
+                    }
+                    if (a == ORPHAN_ARC) {
+                        d = INFINITE_D;
+                        break;
+                    }
+                    j = arcs[a].head;
+                }
+                if (d < INFINITE_D) /* j originates from the source - done */
+                {
+                    if (d < d_min) {
+                        a0_min = a0;
+                        d_min  = d;
+                    }
+                    /* set marks along the path */
+                    for (j = arcs[a0].head; TS[j] != TIME;
+                         j = arcs[parent[j]].head) {
+                        TS[j]   = TIME;
+                        DIST[j] = d--;
+                    }
+                }
+            }
+        }
+
+    if ((parent[i] = a0_min) != NONE) {
+        TS[i]   = TIME;
+        DIST[i] = d_min + 1;
+    } else {
+        /* no parent is found */
+        add_to_changed_list(i);
+
+        /* process neighbors */
+        for (a0 = first[i]; a0 != NONE; a0 = arcs[a0].next) {
+            j = arcs[a0].head;
+            if (!is_sink(j) && (a = parent[j]) != NONE) {
+                if (arcs[a0 ^ 1].r_cap)
+                    set_active(j);
+                if (a != TERMINAL_ARC && a != ORPHAN_ARC &&
+                    arcs[a].head == i) {
+                    set_orphan_rear(
+                        j); // add j to the end of the adoption list
+                }
+            }
+        }
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void CompactGraph<captype, tcaptype, flowtype>::process_sink_orphan(
+    node_id i) {
+    node_id j;
+    arc_id  a0, a0_min = NONE, a;
+    int     d, d_min   = INFINITE_D;
+
+    /* trying to find a new parent */
+    for (a0 = first[i]; a0 != NONE; a0 = arcs[a0].next)
+        if (arcs[a0].r_cap) {
+            j = arcs[a0].head;
+            if (is_sink(j) && (a = parent[j]) != NONE) {
+                /* checking the origin of j */
+                d = 0;
+                while (1) {
+                    if (TS[j] == TIME) {
+                        d += DIST[j];
+                        break;
+                    }
+                    a = parent[j];
+                    d++;
+                    if (a == TERMINAL_ARC) {
+                        TS[j]   = TIME;
+                        DIST[j] = 1;
+                        break;
+                    }
+                    if (a == ORPHAN_ARC) {
+                        d = INFINITE_D;
+                        break;
+                    }
+                    j = arcs[a].head;
+                }
+                if (d < INFINITE_D) /* j originates from the sink - done */
+                {
+                    if (d < d_min) {
+                        a0_min = a0;
+                        d_min  = d;
+                    }
+                    /* set marks along the path */
+                    for (j = arcs[a0].head; TS[j] != TIME;
+                         j = arcs[parent[j]].head) {
+                        TS[j]   = TIME;
+                        DIST[j] = d--;
+                    }
+                }
+            }
+        }
+
+    if ((parent[i] = a0_min) != NONE) {
+        TS[i]   = TIME;
+        DIST[i] = d_min + 1;
+    } else {
+        /* no parent is found */
+        add_to_changed_list(i);
+
+        /* process neighbors */
+        for (a0 = first[i]; a0 != NONE; a0 = arcs[a0].next) {
+            j = arcs[a0].head;
+            if (is_sink(j) && (a = parent[j]) != NONE) {
+                if (arcs[a0].r_cap)
+                    set_active(j);
+                if (a != TERMINAL_ARC && a != ORPHAN_ARC &&
+                    arcs[a].head == i) {
+                    set_orphan_rear(
+                        j); // add j to the end of the adoption list
+                }
+            }
+        }
+    }
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+flowtype CompactGraph<captype, tcaptype, flowtype>::maxflow(
+    bool reuse_trees, Block<node_id> *_changed_list) {
+    node_id  i, j, current_node = NONE;
+    arc_id   a;
+    nodeptr *np, *np_next;
+
+    if (!nodeptr_block) {
+        nodeptr_block =
+            new DBlock<nodeptr>(NODEPTR_BLOCK_SIZE, error_function);
+    }
+
+    changed_list = _changed_list;
+    if (maxflow_iteration == 0 && reuse_trees)
+        error("reuse_trees cannot be used in the first call to maxflow()!");
+    if (changed_list && !reuse_trees)
+        error("changed_list cannot be used without reuse_trees!");
+
+    if (reuse_trees)
+        maxflow_reuse_trees_init();
+    else
+        maxflow_init();
+
+    // main loop
+    while (1) {
+        if ((i = current_node) != NONE) {
+            next[i] = NONE; /* remove active flag */
+            if (parent[i] == NONE)
+                i = NONE;
+        }
+        if (i == NONE) {
+            if ((i = next_active()) == NONE)
+                break;
+        }
+
+        /* growth */
+        if (!is_sink(i)) {
+            /* grow source tree */
+            for (a = first[i]; a != NONE; a = arcs[a].next)
+                if (arcs[a].r_cap) {
+                    j = arcs[a].head;
+                    if (parent[j] == NONE) {
+                        flags[j] &= ~IS_SINK;
+                        parent[j] = a ^ 1;
+                        TS[j]     = TS[i];
+                        DIST[j]   = DIST[i] + 1;
+                        set_active(j);
+                        add_to_changed_list(j);
+                    } else if (is_sink(j))
+                        break;
+                    else if (TS[j] <= TS[i] && DIST[j] > DIST[i]) {
+                        /* heuristic - trying to make the distance from j to
+                         * the source shorter */
+                        parent[j] = a ^ 1;
+                        TS[j]     = TS[i];
+                        DIST[j]   = DIST[i] + 1;
+                    }
+                }
+        } else {
+            /* grow sink tree */
+            for (a = first[i]; a != NONE; a = arcs[a].next)
+                if (arcs[a ^ 1].r_cap) {
+                    j = arcs[a].head;
+                    if (parent[j] == NONE) {
+                        flags[j] |= IS_SINK;
+                        parent[j] = a ^ 1;
+                        TS[j]     = TS[i];
+                        DIST[j]   = DIST[i] + 1;
+                        set_active(j);
+                        add_to_changed_list(j);
+                    } else if (!is_sink(j)) {
+                        a = a ^ 1;
+                        break;
+                    } else if (TS[j] <= TS[i] && DIST[j] > DIST[i]) {
+                        /* heuristic - trying to make the distance from j to
+                         * the sink shorter */
+                        parent[j] = a ^ 1;
+                        TS[j]     = TS[i];
+                        DIST[j]   = DIST[i] + 1;
+                    }
+                }
+        }
+
+        TIME++;
+
+        if (a != NONE) {
+            next[i]      = i; /* set active flag */
+            current_node = i;
+
+            /* augmentation */
+            augment(a);
+            /* augmentation end */
+
+            /* adoption */
+            while ((np = orphan_first)) {
+                np_next  = np->next;
+                np->next = NULL;
+
+                while ((np = orphan_first)) {
+                    orphan_first = np->next;
+                    i            = np->ptr;
+                    nodeptr_block->Delete(np);
+                    if (!orphan_first)
+                        orphan_last = NULL;
+                    if (is_sink(i))
+                        process_sink_orphan(i);
+                    else
+                        process_source_orphan(i);
+                }
+
+                orphan_first = np_next;
+            }
+            /* adoption end */
+        } else
+            current_node = NONE;
+    }
+
+    if (!reuse_trees || (maxflow_iteration % 64) == 0) {
+        delete nodeptr_block;
+        nodeptr_block = NULL;
+    }
+
+    maxflow_iteration++;
+    return flow;
+}
+
+#undef INFINITE_D
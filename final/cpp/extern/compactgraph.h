@@ -0,0 +1,290 @@
+/* compactgraph.h */
+/*
+        Same maxflow algorithm and interface as Graph (graph.h), with a
+        memory layout meant for large graphs, e.g. grids with tens of
+        millions of arcs:
+
+        - Nodes and arcs are referred to by 32-bit indices instead of
+          pointers, so that the graph is limited to 2^31 - 1 nodes and arcs.
+        - Nodes are stored as a structure of arrays.  The fields read by
+          every growth step (first arc and terminal capacity) are separate
+          from the search tree bookkeeping (parent, active list, timestamp,
+          distance and flags).
+        - The head, next arc and residual capacity of an arc are always
+          read together and stay in one 12-byte record.  Both arcs of an
+          edge are adjacent, the sister of arc a is a^1 and is not stored.
+
+        With 32-bit capacities on a 64-bit machine a node takes 25 bytes
+        instead of 48, and an arc 12 bytes instead of 32.
+
+        Graph::Copy() and the consistency test are not provided.
+*/
+
+#ifndef __COMPACTGRAPH_H__
+#define __COMPACTGRAPH_H__
+
+#include "block.h"
+#include <string.h>
+
+#include <assert.h>
+
+template <typename captype, typename tcaptype, typename flowtype>
+class CompactGraph {
+  public:
+    typedef enum { SOURCE = 0, SINK = 1 } termtype; // terminals
+    typedef int node_id;
+    typedef int arc_id;
+
+    // See Graph for the documentation of the following functions, the only
+    // difference is that arc_id is an index instead of a pointer.
+
+    CompactGraph(int node_num_max, int edge_num_max,
+                 void (*err_function)(const char *) = NULL);
+    ~CompactGraph();
+
+    node_id add_node(int num = 1);
+    void    add_edge(node_id i, node_id j, captype cap, captype rev_cap);
+    void    add_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink);
+
+    flowtype maxflow(bool            reuse_trees  = false,
+                     Block<node_id> *changed_list = NULL);
+    termtype what_segment(node_id i, termtype default_segm = SOURCE);
+
+    void reset();
+
+    arc_id get_first_arc() { return 0; }
+    arc_id get_next_arc(arc_id a) { return a + 1; }
+
+    int  get_node_num() { return node_num; }
+    int  get_arc_num() { return arc_num; }
+    void get_arc_ends(arc_id a, node_id &i, node_id &j);
+    // bytes allocated for nodes and arcs
+    size_t get_memory() {
+        return (size_t)node_max *
+                   (2 * sizeof(arc_id) + sizeof(tcaptype) + sizeof(node_id) +
+                    2 * sizeof(int) + 1) +
+               (size_t)arc_max * sizeof(arc);
+    }
+
+    tcaptype get_trcap(node_id i);
+    captype  get_rcap(arc_id a);
+    void     set_trcap(node_id i, tcaptype trcap);
+    void     set_rcap(arc_id a, captype rcap);
+
+    void mark_node(node_id i);
+    void remove_from_changed_list(node_id i) {
+        assert(i >= 0 && i < node_num && (flags[i] & IN_CHANGED_LIST));
+        flags[i] &= ~IN_CHANGED_LIST;
+    }
+
+  private:
+    // internal variables and functions
+
+    struct arc {
+        node_id head;  // node the arc points to
+        arc_id  next;  // next arc with the same originating node, or NONE
+        captype r_cap; // residual capacity
+    };
+
+    struct nodeptr {
+        node_id  ptr;
+        nodeptr *next;
+    };
+    static const int NODEPTR_BLOCK_SIZE = 128;
+
+    // "null" node or arc, also stands for "no parent" in 'parent'
+    static const int NONE = -1;
+    // special parents, as in Graph
+    static const arc_id TERMINAL_ARC = -2; // to terminal
+    static const arc_id ORPHAN_ARC   = -3; // orphan
+
+    // bits of 'flags'
+    static const unsigned char IS_SINK         = 1; // in the sink tree
+    static const unsigned char IS_MARKED       = 2; // set by mark_node()
+    static const unsigned char IN_CHANGED_LIST = 4; // set by maxflow
+
+    // nodes, read on every growth step
+    arc_id *  first;  // first outcoming arc
+    tcaptype *tr_cap; // if tr_cap > 0 then tr_cap is residual capacity of
+                      // the arc SOURCE->node otherwise -tr_cap is residual
+                      // capacity of the arc node->SINK
+    // nodes, search trees
+    arc_id *       parent; // arc to the node's parent
+    node_id *      next;   // next active node (or the node itself if it is
+                           // the last node in the list), NONE if inactive
+    int *          TS;     // timestamp showing when DIST was computed
+    int *          DIST;   // distance to the terminal
+    unsigned char *flags;
+
+    arc *arcs;
+
+    int node_num, node_max;
+    int arc_num, arc_max; // arc_num = 2*edge_num, arc_max = 2*edge_num_max
+
+    DBlock<nodeptr> *nodeptr_block;
+
+    void (*error_function)(
+        const char *); // this function is called if a error occurs,
+                       // with a corresponding error message
+                       // (or exit(1) is called if it's NULL)
+
+    flowtype flow; // total flow
+
+    // reusing trees & list of changed pixels
+    int             maxflow_iteration; // counter
+    Block<node_id> *changed_list;
+
+    /////////////////////////////////////////////////////////////////////////
+
+    node_id  queue_first[2], queue_last[2]; // list of active nodes
+    nodeptr *orphan_first, *orphan_last;    // list of pointers to orphans
+    int      TIME; // monotonically increasing global counter
+
+    /////////////////////////////////////////////////////////////////////////
+
+    void allocate_nodes(int num_max);
+    void allocate_arcs(int num_max);
+    void error(const char *message);
+
+    bool is_sink(node_id i) { return flags[i] & IS_SINK; }
+
+    // functions for processing active list
+    void    set_active(node_id i);
+    node_id next_active();
+
+    // functions for processing orphans list
+    void set_orphan_front(node_id i); // add to the beginning of the list
+    void set_orphan_rear(node_id i);  // add to the end of the list
+
+    void add_to_changed_list(node_id i);
+
+    void maxflow_init();             // called if reuse_trees == false
+    void maxflow_reuse_trees_init(); // called if reuse_trees == true
+    void augment(arc_id middle_arc);
+    void process_source_orphan(node_id i);
+    void process_sink_orphan(node_id i);
+};
+
+///////////////////////////////////////
+// Implementation - inline functions //
+///////////////////////////////////////
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline typename CompactGraph<captype, tcaptype, flowtype>::node_id
+CompactGraph<captype, tcaptype, flowtype>::add_node(int num) {
+    assert(num > 0);
+
+    if (node_num + num > node_max) {
+        int num_max = node_max + node_max / 2;
+        allocate_nodes(num_max < node_num + num ? node_num + num : num_max);
+    }
+
+    node_id i = node_num;
+    for (node_id k = i; k < i + num; k++) {
+        first[k]  = NONE;
+        tr_cap[k] = 0;
+        parent[k] = NONE;
+        next[k]   = NONE;
+        TS[k]     = 0;
+        DIST[k]   = 0;
+        flags[k]  = 0;
+    }
+    node_num += num;
+    return i;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void CompactGraph<captype, tcaptype, flowtype>::add_tweights(
+    node_id i, tcaptype cap_source, tcaptype cap_sink) {
+    assert(i >= 0 && i < node_num);
+
+    tcaptype delta = tr_cap[i];
+    if (delta > 0)
+        cap_source += delta;
+    else
+        cap_sink -= delta;
+    flow += (cap_source < cap_sink) ? cap_source : cap_sink;
+    tr_cap[i] = cap_source - cap_sink;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void CompactGraph<captype, tcaptype, flowtype>::add_edge(
+    node_id i, node_id j, captype cap, captype rev_cap) {
+    assert(i >= 0 && i < node_num);
+    assert(j >= 0 && j < node_num);
+    assert(i != j);
+    assert(cap >= 0);
+    assert(rev_cap >= 0);
+
+    if (arc_num == arc_max) {
+        int num_max = arc_max + arc_max / 2;
+        allocate_arcs(num_max + (num_max & 1));
+    }
+
+    arc_id a = arc_num++;
+    arc_id a_rev = arc_num++;
+
+    arcs[a].head      = j;
+    arcs[a].next      = first[i];
+    arcs[a].r_cap     = cap;
+    first[i]          = a;
+    arcs[a_rev].head  = i;
+    arcs[a_rev].next  = first[j];
+    arcs[a_rev].r_cap = rev_cap;
+    first[j]          = a_rev;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void CompactGraph<captype, tcaptype, flowtype>::get_arc_ends(
+    arc_id a, node_id &i, node_id &j) {
+    assert(a >= 0 && a < arc_num);
+    i = arcs[a ^ 1].head;
+    j = arcs[a].head;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline tcaptype
+CompactGraph<captype, tcaptype, flowtype>::get_trcap(node_id i) {
+    assert(i >= 0 && i < node_num);
+    return tr_cap[i];
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline captype CompactGraph<captype, tcaptype, flowtype>::get_rcap(arc_id a) {
+    assert(a >= 0 && a < arc_num);
+    return arcs[a].r_cap;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void
+CompactGraph<captype, tcaptype, flowtype>::set_trcap(node_id  i,
+                                                     tcaptype trcap) {
+    assert(i >= 0 && i < node_num);
+    tr_cap[i] = trcap;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void
+CompactGraph<captype, tcaptype, flowtype>::set_rcap(arc_id a, captype rcap) {
+    assert(a >= 0 && a < arc_num);
+    arcs[a].r_cap = rcap;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline typename CompactGraph<captype, tcaptype, flowtype>::termtype
+CompactGraph<captype, tcaptype, flowtype>::what_segment(
+    node_id i, termtype default_segm) {
+    if (parent[i] != NONE) {
+        return is_sink(i) ? SINK : SOURCE;
+    } else {
+        return default_segm;
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void CompactGraph<captype, tcaptype, flowtype>::mark_node(node_id i) {
+    set_active(i);
+    flags[i] |= IS_MARKED;
+}
+
+#endif
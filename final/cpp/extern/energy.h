@@ -78,9 +78,12 @@
 #include "graph.h"
 #include <assert.h>
 
-template <typename captype, typename tcaptype, typename flowtype>
-class Energy : public Graph<captype, tcaptype, flowtype> {
-    typedef Graph<captype, tcaptype, flowtype> GraphT;
+/* The graph the energy is minimized on is a Graph by default, Layout can be
+   any class template with the same interface, e.g. CompactGraph */
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout = Graph>
+class Energy : public Layout<captype, tcaptype, flowtype> {
+    typedef Layout<captype, tcaptype, flowtype> GraphT;
 
   public:
     typedef typename GraphT::node_id Var;
@@ -105,6 +108,10 @@ class Energy : public Graph<captype, tcaptype, flowtype> {
     /* Destructor */
     ~Energy();
 
+    /* Removes all variables and terms, keeping the allocated memory, so that
+       the object can be reused for another energy function */
+    void reset();
+
     /* Adds a new binary variable */
     Var add_variable(int num = 1);
 
@@ -140,10 +147,26 @@ class Energy : public Graph<captype, tcaptype, flowtype> {
                    Value E011, Value E100, Value E101, Value E110,
                    Value E111);
 
+    /* The following two functions change the energy function after
+       'minimize' has been called, so that it can be minimized again
+       with reuse_trees = true.  They mark the nodes they touch.
+
+       Adds E0, E1 to the term of x (same as add_term1()) */
+    void update_term1(Var x, Value E0, Value E1);
+
+    /* Adds E00, E01, E10, E11 to the term E(x,y) which was added by
+       add_term2(x, y, ...) as the edge 'a' (the edge added by the k-th
+       call of add_term2() is get_first_arc() + 2k).  The differences may
+       be irregular, as long as the updated term is regular */
+    void update_term2(Var x, Var y, typename GraphT::arc_id a, Value E00,
+                      Value E01, Value E10, Value E11);
+
     /* After the energy function has been constructed,
        call this function to minimize it.
-       Returns the minimum of the function */
-    TotalValue minimize();
+       Returns the minimum of the function.
+       If reuse_trees is true, the search trees of the previous call are
+       reused, see Graph::maxflow() */
+    TotalValue minimize(bool reuse_trees = false);
 
     /* After 'minimize' has been called, this function
        can be used to determine the value of variable 'x'
@@ -169,39 +192,54 @@ class Energy : public Graph<captype, tcaptype, flowtype> {
 /************************  Implementation ******************************/
 /***********************************************************************/
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline Energy<captype, tcaptype, flowtype>::Energy(
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline Energy<captype, tcaptype, flowtype, Layout>::Energy(
     int var_num_max, int edge_num_max, void (*err_function)(const char *))
-    : Graph<captype, tcaptype, flowtype>(var_num_max, edge_num_max,
-                                         err_function) {
+    : GraphT(var_num_max, edge_num_max, err_function) {
     Econst         = 0;
     error_function = err_function;
 }
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline Energy<captype, tcaptype, flowtype>::~Energy() {}
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline Energy<captype, tcaptype, flowtype, Layout>::~Energy() {}
+
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline void Energy<captype, tcaptype, flowtype, Layout>::reset() {
+    GraphT::reset();
+    Econst = 0;
+}
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline typename Energy<captype, tcaptype, flowtype>::Var
-Energy<captype, tcaptype, flowtype>::add_variable(int num) {
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline typename Energy<captype, tcaptype, flowtype, Layout>::Var
+Energy<captype, tcaptype, flowtype, Layout>::add_variable(int num) {
     return GraphT::add_node(num);
 }
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline void Energy<captype, tcaptype, flowtype>::add_constant(Value A) {
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline void
+Energy<captype, tcaptype, flowtype, Layout>::add_constant(Value A) {
     Econst += A;
 }
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline void Energy<captype, tcaptype, flowtype>::add_term1(Var x, Value A,
-                                                           Value B) {
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline void
+Energy<captype, tcaptype, flowtype, Layout>::add_term1(Var x, Value A,
+                                                       Value B) {
     this->add_tweights(x, B, A);
 }
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline void Energy<captype, tcaptype, flowtype>::add_term2(Var x, Var y,
-                                                           Value A, Value B,
-                                                           Value C, Value D) {
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline void
+Energy<captype, tcaptype, flowtype, Layout>::add_term2(Var x, Var y, Value A,
+                                                       Value B, Value C,
+                                                       Value D) {
     /*
        E = A A  +  0   B-A
            D D     C-D 0
@@ -239,8 +277,9 @@ inline void Energy<captype, tcaptype, flowtype>::add_term2(Var x, Var y,
     }
 }
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline void Energy<captype, tcaptype, flowtype>::add_term3(
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline void Energy<captype, tcaptype, flowtype, Layout>::add_term3(
     Var x, Var y, Var z, Value E000, Value E001, Value E010, Value E011,
     Value E100, Value E101, Value E110, Value E111) {
     register Value pi =
@@ -301,14 +340,64 @@ inline void Energy<captype, tcaptype, flowtype>::add_term3(
     }
 }
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline typename Energy<captype, tcaptype, flowtype>::TotalValue
-Energy<captype, tcaptype, flowtype>::minimize() {
-    return Econst + GraphT::maxflow();
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline void
+Energy<captype, tcaptype, flowtype, Layout>::update_term1(Var x, Value A,
+                                                          Value B) {
+    this->add_tweights(x, B, A);
+    this->mark_node(x);
+}
+
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline void Energy<captype, tcaptype, flowtype, Layout>::update_term2(
+    Var x, Var y, typename GraphT::arc_id a, Value A, Value B, Value C,
+    Value D) {
+    /* Same decomposition as add_term2(), the residual capacities of the
+       edge take the place of add_edge() */
+    this->add_tweights(x, D, A);
+    B -= A;
+    C -= D;
+
+    typename GraphT::arc_id a_rev = this->get_next_arc(a);
+    Value                   r     = this->get_rcap(a) + B;
+    Value                   r_rev = this->get_rcap(a_rev) + C;
+
+    assert(r + r_rev >= 0); /* check regularity */
+    if (r < 0) {
+        /* Write r*[x=0][y=1] as
+           -r*[x=1] + r*[y=1] + r*[x=1][y=0]
+        */
+        this->add_tweights(x, -r, 0);
+        this->add_tweights(y, r, 0);
+        r_rev += r;
+        r = 0;
+    } else if (r_rev < 0) {
+        /* Write r_rev*[x=1][y=0] as
+           -r_rev*[y=1] + r_rev*[x=1] + r_rev*[x=0][y=1]
+        */
+        this->add_tweights(y, -r_rev, 0);
+        this->add_tweights(x, r_rev, 0);
+        r += r_rev;
+        r_rev = 0;
+    }
+    this->set_rcap(a, r);
+    this->set_rcap(a_rev, r_rev);
+    this->mark_node(x);
+    this->mark_node(y);
+}
+
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline typename Energy<captype, tcaptype, flowtype, Layout>::TotalValue
+Energy<captype, tcaptype, flowtype, Layout>::minimize(bool reuse_trees) {
+    return Econst + GraphT::maxflow(reuse_trees);
 }
 
-template <typename captype, typename tcaptype, typename flowtype>
-inline int Energy<captype, tcaptype, flowtype>::get_var(Var x) {
+template <typename captype, typename tcaptype, typename flowtype,
+          template <typename, typename, typename> class Layout>
+inline int Energy<captype, tcaptype, flowtype, Layout>::get_var(Var x) {
     return (int)this->what_segment(x);
 }
 
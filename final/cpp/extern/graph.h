@@ -161,6 +161,11 @@ class Graph {
     int  get_arc_num() { return (int)(arc_last - arcs); }
     void get_arc_ends(arc_id a, node_id &i,
                       node_id &j); // returns i,j to that a = i->j
+    // bytes allocated for nodes and arcs
+    size_t get_memory() {
+        return (node_max - nodes) * sizeof(node) +
+               (arc_max - arcs) * sizeof(arc);
+    }
 
     ///////////////////////////////////////////////////
     // 3. Functions for reading residual capacities. //
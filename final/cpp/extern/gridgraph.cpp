@@ -0,0 +1,747 @@
+/* gridgraph.cpp */
+/*
+        Maxflow of GridGraph, a port of maxflow.cpp where the arcs of a node
+        are its up to 4 neighbors on the grid, and a parallel push-relabel
+        on the same storage.
+*/
+
+#include "gridgraph.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define INFINITE_D                                                           \
+    ((int)(((unsigned)-1) / 2)) /* infinite distance to the terminal */
+
+template <typename captype, typename tcaptype, typename flowtype>
+GridGraph<captype, tcaptype, flowtype>::GridGraph(
+    int width, int height, void (*err_function)(const char *))
+    : width(width), height(height), inflow(NULL), work(NULL), node_num(0),
+      algorithm(BOYKOV_KOLMOGOROV), nodeptr_block(NULL),
+      error_function(err_function) {
+    int num = width * height;
+
+    offset[0] = -1;
+    offset[1] = 1;
+    offset[2] = -width;
+    offset[3] = width;
+
+    tr_cap = (tcaptype *)malloc(num * sizeof(tcaptype));
+    r_cap  = (captype *)malloc(4 * num * sizeof(captype));
+    parent = (arc_id *)malloc(num * sizeof(arc_id));
+    next   = (node_id *)malloc(num * sizeof(node_id));
+    TS     = (int *)malloc(num * sizeof(int));
+    DIST   = (int *)malloc(num * sizeof(int));
+    flags  = (unsigned char *)malloc(num);
+    if (!tr_cap || !r_cap || !parent || !next || !TS || !DIST || !flags)
+        error("Not enough memory!");
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) {
+            unsigned char f = 0;
+            if (x > 0)
+                f |= HAS_NEIGHBOR << 0;
+            if (x < width - 1)
+                f |= HAS_NEIGHBOR << 1;
+            if (y > 0)
+                f |= HAS_NEIGHBOR << 2;
+            if (y < height - 1)
+                f |= HAS_NEIGHBOR << 3;
+            flags[x + y * width] = f;
+        }
+
+    reset();
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+GridGraph<captype, tcaptype, flowtype>::~GridGraph() {
+    if (nodeptr_block) {
+        delete nodeptr_block;
+        nodeptr_block = NULL;
+    }
+    free(tr_cap);
+    free(r_cap);
+    free(parent);
+    free(next);
+    free(TS);
+    free(DIST);
+    free(flags);
+    free(inflow);
+    free(work);
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype, tcaptype, flowtype>::reset() {
+    int num = width * height;
+
+    node_num = 0;
+    // Edges are added to the capacities in place, all of them start at zero
+    memset(tr_cap, 0, num * sizeof(tcaptype));
+    memset(r_cap, 0, 4 * num * sizeof(captype));
+
+    if (nodeptr_block) {
+        delete nodeptr_block;
+        nodeptr_block = NULL;
+    }
+
+    flow = 0;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype, tcaptype, flowtype>::error(const char *message) {
+    if (error_function)
+        (*error_function)(message);
+    exit(1);
+}
+
+/***********************************************************************/
+
+/*
+        Functions for processing active list, see maxflow.cpp.
+        next[i] is the next node in the list (or i, if i is the last node
+        in the list), and NONE iff i is not in the list.
+*/
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void GridGraph<captype, tcaptype, flowtype>::set_active(node_id i) {
+    if (next[i] == NONE) {
+        /* it's not in the list yet */
+        if (queue_last[1] != NONE)
+            next[queue_last[1]] = i;
+        else
+            queue_first[1] = i;
+        queue_last[1] = i;
+        next[i]       = i;
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline typename GridGraph<captype, tcaptype, flowtype>::node_id
+GridGraph<captype, tcaptype, flowtype>::next_active() {
+    node_id i;
+
+    while (1) {
+        if ((i = queue_first[0]) == NONE) {
+            queue_first[0] = i = queue_first[1];
+            queue_last[0]      = queue_last[1];
+            queue_first[1]     = NONE;
+            queue_last[1]      = NONE;
+            if (i == NONE)
+                return NONE;
+        }
+
+        /* remove it from the active list */
+        if (next[i] == i)
+            queue_first[0] = queue_last[0] = NONE;
+        else
+            queue_first[0] = next[i];
+        next[i] = NONE;
+
+        /* a node in the list is active iff it has a parent */
+        if (parent[i] != NONE)
+            return i;
+    }
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void
+GridGraph<captype, tcaptype, flowtype>::set_orphan_front(node_id i) {
+    nodeptr *np;
+    parent[i]    = ORPHAN_ARC;
+    np           = nodeptr_block->New();
+    np->ptr      = i;
+    np->next     = orphan_first;
+    orphan_first = np;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+inline void
+GridGraph<captype, tcaptype, flowtype>::set_orphan_rear(node_id i) {
+    nodeptr *np;
+    parent[i] = ORPHAN_ARC;
+    np        = nodeptr_block->New();
+    np->ptr   = i;
+    if (orphan_last)
+        orphan_last->next = np;
+    else
+        orphan_first = np;
+    orphan_last = np;
+    np->next    = NULL;
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype, tcaptype, flowtype>::maxflow_init() {
+    node_id i;
+
+    queue_first[0] = queue_last[0] = NONE;
+    queue_first[1] = queue_last[1] = NONE;
+    orphan_first                   = NULL;
+
+    TIME = 0;
+
+    for (i = 0; i < node_num; i++) {
+        next[i] = NONE;
+        TS[i]   = TIME;
+        if (tr_cap[i] > 0) {
+            /* i is connected to the source */
+            flags[i] &= ~IS_SINK;
+            parent[i] = TERMINAL_ARC;
+            set_active(i);
+            DIST[i] = 1;
+        } else if (tr_cap[i] < 0) {
+            /* i is connected to the sink */
+            flags[i] |= IS_SINK;
+            parent[i] = TERMINAL_ARC;
+            set_active(i);
+            DIST[i] = 1;
+        } else {
+            parent[i] = NONE;
+        }
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype, tcaptype, flowtype>::augment(arc_id middle_arc) {
+    node_id  i;
+    arc_id   a;
+    tcaptype bottleneck;
+
+    /* 1. Finding bottleneck capacity */
+    /* 1a - the source tree */
+    bottleneck = r_cap[middle_arc];
+    for (i = middle_arc >> 2;; i = head(a)) {
+        a = parent[i];
+        if (a == TERMINAL_ARC)
+            break;
+        if (bottleneck > r_cap[sister(a)])
+            bottleneck = r_cap[sister(a)];
+    }
+    if (bottleneck > tr_cap[i])
+        bottleneck = tr_cap[i];
+    /* 1b - the sink tree */
+    for (i = head(middle_arc);; i = head(a)) {
+        a = parent[i];
+        if (a == TERMINAL_ARC)
+            break;
+        if (bottleneck > r_cap[a])
+            bottleneck = r_cap[a];
+    }
+    if (bottleneck > -tr_cap[i])
+        bottleneck = -tr_cap[i];
+
+    /* 2. Augmenting */
+    /* 2a - the source tree */
+    r_cap[sister(middle_arc)] += bottleneck;
+    r_cap[middle_arc] -= bottleneck;
+    for (i = middle_arc >> 2;; i = head(a)) {
+        a = parent[i];
+        if (a == TERMINAL_ARC)
+            break;
+        r_cap[a] += bottleneck;
+        r_cap[sister(a)] -= bottleneck;
+        if (!r_cap[sister(a)]) {
+            set_orphan_front(
+                i); // add i to the beginning of the adoption list
+        }
+    }
+    tr_cap[i] -= bottleneck;
+    if (!tr_cap[i]) {
+        set_orphan_front(i); // add i to the beginning of the adoption list
+    }
+    /* 2b - the sink tree */
+    for (i = head(middle_arc);; i = head(a)) {
+        a = parent[i];
+        if (a == TERMINAL_ARC)
+            break;
+        r_cap[sister(a)] += bottleneck;
+        r_cap[a] -= bottleneck;
+        if (!r_cap[a]) {
+            set_orphan_front(
+                i); // add i to the beginning of the adoption list
+        }
+    }
+    tr_cap[i] += bottleneck;
+    if (!tr_cap[i]) {
+        set_orphan_front(i); // add i to the beginning of the adoption list
+    }
+
+    flow += bottleneck;
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype, tcaptype, flowtype>::process_source_orphan(
+    node_id i) {
+    node_id j;
+    arc_id  a0, a0_min = NONE, a;
+    int     k, d, d_min = INFINITE_D;
+
+    /* trying to find a new parent */
+    for (k = 0; k < 4; k++) {
+        if (!has_arc(i, k))
+            continue;
+        a0 = (i << 2) | k;
+        if (r_cap[sister(a0)]) {
+            j = head(a0);
+            if (!is_sink(j) && (a = parent[j]) != NONE) {
+                /* checking the origin of j */
+                d = 0;
+                while (1) {
+                    if (TS[j] == TIME) {
+                        d += DIST[j];
+                        break;
+                    }
+                    a = parent[j];
+                    d++;
+                    if (a == TERMINAL_ARC) {
+                        TS[j]   = TIME;
+                        DIST[j] = 1;
+                        break;
+                    }
+                    if (a == ORPHAN_ARC) {
+                        d = INFINITE_D;
+                        break;
+                    }
+                    j = head(a);
+                }
+                if (d < INFINITE_D) /* j originates from the source - done */
+                {
+                    if (d < d_min) {
+                        a0_min = a0;
+                        d_min  = d;
+                    }
+                    /* set marks along the path */
+                    for (j = head(a0); TS[j] != TIME; j = head(parent[j])) {
+                        TS[j]   = TIME;
+                        DIST[j] = d--;
+                    }
+                }
+            }
+        }
+    }
+
+    if ((parent[i] = a0_min) != NONE) {
+        TS[i]   = TIME;
+        DIST[i] = d_min + 1;
+    } else {
+        /* no parent is found */
+
+        /* process neighbors */
+        for (k = 0; k < 4; k++) {
+            if (!has_arc(i, k))
+                continue;
+            a0 = (i << 2) | k;
+            j  = head(a0);
+            if (!is_sink(j) && (a = parent[j]) != NONE) {
+                if (r_cap[sister(a0)])
+                    set_active(j);
+                if (a != TERMINAL_ARC && a != ORPHAN_ARC && head(a) == i) {
+                    set_orphan_rear(
+                        j); // add j to the end of the adoption list
+                }
+            }
+        }
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype, tcaptype, flowtype>::process_sink_orphan(node_id i) {
+    node_id j;
+    arc_id  a0, a0_min = NONE, a;
+    int     k, d, d_min = INFINITE_D;
+
+    /* trying to find a new parent */
+    for (k = 0; k < 4; k++) {
+        if (!has_arc(i, k))
+            continue;
+        a0 = (i << 2) | k;
+        if (r_cap[a0]) {
+            j = head(a0);
+            if (is_sink(j) && (a = parent[j]) != NONE) {
+                /* checking the origin of j */
+                d = 0;
+                while (1) {
+                    if (TS[j] == TIME) {
+                        d += DIST[j];
+                        break;
+                    }
+                    a = parent[j];
+                    d++;
+                    if (a == TERMINAL_ARC) {
+                        TS[j]   = TIME;
+                        DIST[j] = 1;
+                        break;
+                    }
+                    if (a == ORPHAN_ARC) {
+                        d = INFINITE_D;
+                        break;
+                    }
+                    j = head(a);
+                }
+                if (d < INFINITE_D) /* j originates from the sink - done */
+                {
+                    if (d < d_min) {
+                        a0_min = a0;
+                        d_min  = d;
+                    }
+                    /* set marks along the path */
+                    for (j = head(a0); TS[j] != TIME; j = head(parent[j])) {
+                        TS[j]   = TIME;
+                        DIST[j] = d--;
+                    }
+                }
+            }
+        }
+    }
+
+    if ((parent[i] = a0_min) != NONE) {
+        TS[i]   = TIME;
+        DIST[i] = d_min + 1;
+    } else {
+        /* no parent is found */
+
+        /* process neighbors */
+        for (k = 0; k < 4; k++) {
+            if (!has_arc(i, k))
+                continue;
+            a0 = (i << 2) | k;
+            j  = head(a0);
+            if (is_sink(j) && (a = parent[j]) != NONE) {
+                if (r_cap[a0])
+                    set_active(j);
+                if (a != TERMINAL_ARC && a != ORPHAN_ARC && head(a) == i) {
+                    set_orphan_rear(
+                        j); // add j to the end of the adoption list
+                }
+            }
+        }
+    }
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+flowtype GridGraph<captype, tcaptype, flowtype>::maxflow(
+    bool reuse_trees, Block<node_id> *changed_list) {
+    node_id  i, j, current_node = NONE;
+    arc_id   a;
+    int      k;
+    nodeptr *np, *np_next;
+
+    if (reuse_trees || changed_list)
+        error("GridGraph does not support reuse_trees!");
+
+    if (algorithm == PUSH_RELABEL)
+        return push_relabel();
+
+    if (!nodeptr_block) {
+        nodeptr_block =
+            new DBlock<nodeptr>(NODEPTR_BLOCK_SIZE, error_function);
+    }
+
+    maxflow_init();
+
+    // main loop
+    while (1) {
+        if ((i = current_node) != NONE) {
+            next[i] = NONE; /* remove active flag */
+            if (parent[i] == NONE)
+                i = NONE;
+        }
+        if (i == NONE) {
+            if ((i = next_active()) == NONE)
+                break;
+        }
+
+        /* growth */
+        a = NONE;
+        if (!is_sink(i)) {
+            /* grow source tree */
+            for (k = 0; k < 4; k++) {
+                if (!has_arc(i, k) || !r_cap[(i << 2) | k])
+                    continue;
+                j = i + offset[k];
+                if (parent[j] == NONE) {
+                    flags[j] &= ~IS_SINK;
+                    parent[j] = (j << 2) | (k ^ 1);
+                    TS[j]     = TS[i];
+                    DIST[j]   = DIST[i] + 1;
+                    set_active(j);
+                } else if (is_sink(j)) {
+                    a = (i << 2) | k;
+                    break;
+                } else if (TS[j] <= TS[i] && DIST[j] > DIST[i]) {
+                    /* heuristic - trying to make the distance from j to
+                     * the source shorter */
+                    parent[j] = (j << 2) | (k ^ 1);
+                    TS[j]     = TS[i];
+                    DIST[j]   = DIST[i] + 1;
+                }
+            }
+        } else {
+            /* grow sink tree */
+            for (k = 0; k < 4; k++) {
+                if (!has_arc(i, k))
+                    continue;
+                j = i + offset[k];
+                if (!r_cap[(j << 2) | (k ^ 1)])
+                    continue;
+                if (parent[j] == NONE) {
+                    flags[j] |= IS_SINK;
+                    parent[j] = (j << 2) | (k ^ 1);
+                    TS[j]     = TS[i];
+                    DIST[j]   = DIST[i] + 1;
+                    set_active(j);
+                } else if (!is_sink(j)) {
+                    a = (j << 2) | (k ^ 1);
+                    break;
+                } else if (TS[j] <= TS[i] && DIST[j] > DIST[i]) {
+                    /* heuristic - trying to make the distance from j to
+                     * the sink shorter */
+                    parent[j] = (j << 2) | (k ^ 1);
+                    TS[j]     = TS[i];
+                    DIST[j]   = DIST[i] + 1;
+                }
+            }
+        }
+
+        TIME++;
+
+        if (a != NONE) {
+            next[i]      = i; /* set active flag */
+            current_node = i;
+
+            /* augmentation */
+            augment(a);
+            /* augmentation end */
+
+            /* adoption */
+            while ((np = orphan_first)) {
+                np_next  = np->next;
+                np->next = NULL;
+
+                while ((np = orphan_first)) {
+                    orphan_first = np->next;
+                    i            = np->ptr;
+                    nodeptr_block->Delete(np);
+                    if (!orphan_first)
+                        orphan_last = NULL;
+                    if (is_sink(i))
+                        process_sink_orphan(i);
+                    else
+                        process_source_orphan(i);
+                }
+
+                orphan_first = np_next;
+            }
+            /* adoption end */
+        } else
+            current_node = NONE;
+    }
+
+    delete nodeptr_block;
+    nodeptr_block = NULL;
+
+    return flow;
+}
+
+/***********************************************************************/
+
+/*
+        Push-relabel.  Flow from the source is pushed into the nodes at
+        once: tr_cap > 0 is the excess of a node, and tr_cap < 0 the
+        residual capacity to the sink, which absorbs any flow pushed into
+        the node.  DIST is the height label, the sink has height 0 and a
+        node with a height of at least inf cannot reach it any more.
+
+        Every round, all active nodes (with an excess and a height below
+        inf) push along their admissible arcs at once, then those with an
+        excess left relabel at once.  During the pushes only arcs from a
+        node to a lower neighbor change, so two neighbors never change the
+        same pair of arcs, and the flow pushed into a node is collected in
+        inflow.  Relabels read the heights of the previous round and write
+        the new ones into TS first.  The nodes active in the next round are
+        among those active or pushed into in this round, next[i] is the
+        last round i was put in the list.
+*/
+
+template <typename captype, typename tcaptype, typename flowtype>
+void GridGraph<captype, tcaptype, flowtype>::global_relabel(int inf) {
+    node_id i, j, first = 0, last = 0;
+    int     k;
+
+    /* breadth-first search from the sink along the residual arcs, next
+     * is the queue */
+    for (i = 0; i < node_num; i++) {
+        if (tr_cap[i] < 0) {
+            DIST[i]      = 1;
+            next[last++] = i;
+        } else
+            DIST[i] = inf;
+    }
+    while (first < last) {
+        i = next[first++];
+        for (k = 0; k < 4; k++) {
+            if (!has_arc(i, k))
+                continue;
+            j = i + offset[k];
+            /* arc j->i is arc k^1 of j */
+            if (j >= node_num || DIST[j] != inf || !r_cap[(j << 2) | (k ^ 1)])
+                continue;
+            DIST[j]      = DIST[i] + 1;
+            next[last++] = j;
+        }
+    }
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+flowtype GridGraph<captype, tcaptype, flowtype>::push_relabel() {
+    int      n   = node_num;
+    int      inf = n + 1; // no path to the sink is longer than n
+    int      relabels = 0, round = 0;
+    int      num_active = 0, num_pushed;
+    flowtype absorbed;
+
+    if (!inflow) {
+        inflow = (tcaptype *)calloc(width * height, sizeof(tcaptype));
+        work   = (node_id *)malloc(3 * width * height * sizeof(node_id));
+        if (!inflow || !work)
+            error("Not enough memory!");
+    }
+    node_id *active = work;         // nodes active in this round
+    node_id *pushed = work + n;     // nodes pushed into in this round
+    node_id *later  = work + 2 * n; // nodes active in the next round
+
+    while (1) {
+        if (round == 0 || relabels > n / 2) {
+            /* exact heights now and then, relabeling by one at a time is
+             * slow to find out that a region is cut off from the sink */
+            global_relabel(inf);
+            relabels   = 0;
+            num_active = 0;
+            for (node_id i = 0; i < n; i++) {
+                next[i] = -1;
+                if (tr_cap[i] > 0 && DIST[i] < inf)
+                    active[num_active++] = i;
+            }
+        }
+        if (!num_active)
+            break;
+        round++;
+
+        /* push */
+        num_pushed = 0;
+#pragma omp parallel for
+        for (int m = 0; m < num_active; m++) {
+            node_id  i  = active[m];
+            tcaptype ex = tr_cap[i];
+            int      d  = DIST[i];
+            for (int k = 0; k < 4 && ex > 0; k++) {
+                /* the height is checked first: a neighbor that could push
+                 * into i at the same time is never admissible for i */
+                if (!has_arc(i, k))
+                    continue;
+                node_id j = i + offset[k];
+                arc_id  a = (i << 2) | k;
+                if (j >= n || DIST[j] != d - 1 || !r_cap[a])
+                    continue;
+                captype amount = r_cap[a] < ex ? r_cap[a] : ex;
+                r_cap[a] -= amount;
+                r_cap[(j << 2) | (k ^ 1)] += amount;
+                ex -= amount;
+                tcaptype before;
+#pragma omp atomic capture
+                {
+                    before = inflow[j];
+                    inflow[j] += amount;
+                }
+                if (!before) {
+                    int p;
+#pragma omp atomic capture
+                    p = num_pushed++;
+                    pushed[p] = j;
+                }
+            }
+            tr_cap[i] = ex;
+        }
+
+        /* relabel, an active node with an excess left has saturated all
+         * its admissible arcs */
+        int num_relabeled = 0;
+#pragma omp parallel for reduction(+ : num_relabeled)
+        for (int m = 0; m < num_active; m++) {
+            node_id i = active[m];
+            int     d = DIST[i];
+            if (tr_cap[i] > 0) {
+                d = inf;
+                for (int k = 0; k < 4; k++) {
+                    if (!has_arc(i, k) || !r_cap[(i << 2) | k])
+                        continue;
+                    int dj = DIST[i + offset[k]] + 1;
+                    if (dj < d)
+                        d = dj;
+                }
+                num_relabeled++;
+            }
+            TS[i] = d;
+        }
+        relabels += num_relabeled;
+
+        /* collect the active nodes of the next round */
+        int num_next = 0;
+#pragma omp parallel for
+        for (int m = 0; m < num_active; m++) {
+            node_id i = active[m];
+            DIST[i]   = TS[i];
+            if (tr_cap[i] > 0 && DIST[i] < inf) {
+                next[i] = round;
+                int p;
+#pragma omp atomic capture
+                p = num_next++;
+                later[p] = i;
+            }
+        }
+        absorbed = 0;
+#pragma omp parallel for reduction(+ : absorbed)
+        for (int m = 0; m < num_pushed; m++) {
+            node_id  i  = pushed[m];
+            tcaptype ex = tr_cap[i];
+            if (ex < 0)
+                absorbed += (-ex < inflow[i]) ? -ex : inflow[i];
+            tr_cap[i] = ex + inflow[i];
+            inflow[i] = 0;
+            if (tr_cap[i] > 0 && DIST[i] < inf && next[i] != round) {
+                next[i] = round;
+                int p;
+#pragma omp atomic capture
+                p = num_next++;
+                later[p] = i;
+            }
+        }
+        flow += absorbed;
+
+        node_id *swap = active;
+        active        = later;
+        later         = swap;
+        num_active    = num_next;
+    }
+
+    /* the nodes that can still reach the sink are on its side of the
+     * minimum cut */
+    global_relabel(inf);
+    for (node_id i = 0; i < n; i++) {
+        parent[i] = TERMINAL_ARC;
+        if (DIST[i] < inf)
+            flags[i] |= IS_SINK;
+        else
+            flags[i] &= ~IS_SINK;
+    }
+
+    return flow;
+}
+
+#undef INFINITE_D
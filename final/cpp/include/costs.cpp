@@ -0,0 +1,144 @@
+#include "costs.hpp"
+#include "simd.hpp"
+
+#include <omp.h>
+
+/* Row kernel accumulating `sign * term(l[i], r[i])` into `acc[i]` */
+using row_kernel = void (*)(uint8_t const *l, uint8_t const *r, int *acc,
+                            int const &n, int const &sign);
+
+/* Aggregates `term(L(y, c), R(y, c - d))` over the windows of pixels in
+ * [y0, y1) x [x0, x1), whose windows must fit in both images.  Column sums
+ * slide downwards and row sums slide rightwards, the result of pixel (y, x)
+ * is written to `out[(y - y0) * step + x - x0]`.
+ */
+static void box_rect(cv::Mat const &limg, cv::Mat const &rimg,
+                     int const &wr, int const &d, int const &y0,
+                     int const &y1, int const &x0, int const &x1, int *out,
+                     std::size_t const &step, row_kernel const &term) {
+    /* Column sums over rows [y - wr, y + wr), of columns [c0, c1) */
+    int              c0 = x0 - wr;
+    int              c1 = x1 + wr - 1;
+    std::vector<int> colsum(c1 - c0, 0);
+    auto             accumulate = [&](int const &r, int const &sign) {
+        term(limg.ptr<uint8_t>(r) + c0, rimg.ptr<uint8_t>(r) + c0 - d,
+             colsum.data(), c1 - c0, sign);
+    };
+    for (int r = y0 - wr; r < y0 + wr; ++r) {
+        accumulate(r, 1);
+    }
+    for (int y = y0; y < y1; ++y) {
+        if (y > y0) {
+            accumulate(y + wr - 1, 1);
+            accumulate(y - wr - 1, -1);
+        }
+        int *o   = out + (y - y0) * step;
+        int  sum = 0;
+        for (int c = x0 - wr; c < x0 + wr; ++c) {
+            sum += colsum[c - c0];
+        }
+        o[0] = sum;
+        for (int x = x0 + 1; x < x1; ++x) {
+            sum += colsum[x + wr - 1 - c0] - colsum[x - wr - 1 - c0];
+            o[x - x0] = sum;
+        }
+    }
+}
+
+/* Aggregates `term` over the window of every pixel, rows are split into
+ * one band per thread.
+ */
+static void box_slice(cv::Mat const &limg, cv::Mat const &rimg,
+                      int const &wr, int const &d, cv::Mat &cost,
+                      row_kernel const &term) {
+    int rows = limg.rows;
+    int cols = limg.cols;
+    cost.create(rows, cols, CV_32SC1);
+    cost = std::numeric_limits<int>::max();
+
+    /* Range of pixels whose window fits in both images */
+    int ylo = wr, yhi = rows - wr;
+    int xlo = wr + d, xhi = cols - wr;
+    if (ylo >= yhi || xlo >= xhi) {
+        return;
+    }
+
+    int nbands = std::min(omp_get_max_threads(), yhi - ylo);
+#pragma omp parallel for schedule(static)
+    for (int b = 0; b < nbands; ++b) {
+        int y0 = ylo + (yhi - ylo) * b / nbands;
+        int y1 = ylo + (yhi - ylo) * (b + 1) / nbands;
+        box_rect(limg, rimg, wr, d, y0, y1, xlo, xhi,
+                 cost.ptr<int>(y0) + xlo, cost.step1(), term);
+    }
+}
+
+void sad_slice(cv::Mat const &limg, cv::Mat const &rimg, int const &wr,
+               int const &d, cv::Mat &cost) {
+    simd::dispatch([&](auto isa) {
+        box_slice(limg, rimg, wr, d, cost, &decltype(isa)::absdiff_acc);
+    });
+}
+
+/* Aggregates `term` over the windows of the pixels of `roi` on the calling
+ * thread.
+ */
+static void box_block(cv::Mat const &limg, cv::Mat const &rimg,
+                      int const &wr, int const &d, cv::Rect const &roi,
+                      cv::Mat &cost, row_kernel const &term) {
+    cost.create(roi.height, roi.width, CV_32SC1);
+    cost = std::numeric_limits<int>::max();
+
+    int y0 = std::max(roi.y, wr);
+    int y1 = std::min(roi.y + roi.height, limg.rows - wr);
+    int x0 = std::max(roi.x, wr + d);
+    int x1 = std::min(roi.x + roi.width, limg.cols - wr);
+    if (y0 >= y1 || x0 >= x1) {
+        return;
+    }
+    box_rect(limg, rimg, wr, d, y0, y1, x0, x1,
+             cost.ptr<int>(y0 - roi.y) + x0 - roi.x, cost.step1(), term);
+}
+
+void sad_block(cv::Mat const &limg, cv::Mat const &rimg, int const &wr,
+               int const &d, cv::Rect const &roi, cv::Mat &cost) {
+    simd::dispatch([&](auto isa) {
+        box_block(limg, rimg, wr, d, roi, cost, &decltype(isa)::absdiff_acc);
+    });
+}
+
+void xcorr_block(cv::Mat const &limg, cv::Mat const &rimg, int const &wr,
+                 int const &d, cv::Rect const &roi, cv::Mat &cost) {
+    simd::dispatch([&](auto isa) {
+        box_block(limg, rimg, wr, d, roi, cost, &decltype(isa)::product_acc);
+    });
+}
+
+void box_stats(cv::Mat const &img, int const &wr, cv::Mat &sum,
+               cv::Mat &sqsum) {
+    int     rows = img.rows;
+    int     cols = img.cols;
+    cv::Mat isum, isqsum;
+    cv::integral(img, isum, isqsum, CV_64F, CV_64F);
+
+    sum   = cv::Mat(rows, cols, CV_64FC1);
+    sqsum = cv::Mat(rows, cols, CV_64FC1);
+    sum   = 0;
+    sqsum = 0;
+#pragma omp parallel for
+    for (int y = wr; y < rows - wr; ++y) {
+        double const *stop = isum.ptr<double>(y - wr);
+        double const *sbot = isum.ptr<double>(y + wr);
+        double const *qtop = isqsum.ptr<double>(y - wr);
+        double const *qbot = isqsum.ptr<double>(y + wr);
+        double *      s    = sum.ptr<double>(y);
+        double *      q    = sqsum.ptr<double>(y);
+        for (int x = wr; x < cols - wr; ++x) {
+            s[x] = sbot[x + wr] - sbot[x - wr] - stop[x + wr] + stop[x - wr];
+            q[x] = qbot[x + wr] - qbot[x - wr] - qtop[x + wr] + qtop[x - wr];
+        }
+    }
+}
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 10:12 [CST]
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "globla.hpp"
+
+/* Window sums of absolute differences for a single disparity.
+ * Every disparity costs O(rows * cols) regardless of the window radius,
+ * since the windows are aggregated with running column/row sums.
+ * @param `{l,r}img` **Rectified** grayscale (CV_8UC1) stereo images.
+ * @param `wr` Window radius, the window of pixel (y, x) spans rows
+ *        [y - wr, y + wr) and columns [x - wr, x + wr).
+ * @param `d` Disparity, left pixel (y, x) is compared against right pixel
+ *        (y, x - d).
+ * @param `cost` Output CV_32SC1 image, pixels whose window does not fit in
+ *        both images are set to `INT_MAX`.
+ */
+void sad_slice(cv::Mat const &limg, cv::Mat const &rimg, int const &wr,
+               int const &d, cv::Mat &cost);
+
+/* Window sums of absolute differences for a single disparity, over the
+ * pixels of `roi` only.  Unlike `sad_slice()`, this runs on the calling
+ * thread, so that callers can process many small blocks in parallel.
+ * @param `roi` Pixels to evaluate, (y, x) is written to `cost` at
+ *        (y - roi.y, x - roi.x).
+ * @param `cost` Output CV_32SC1 image of the size of `roi`, pixels whose
+ *        window does not fit in both images are set to `INT_MAX`.
+ */
+void sad_block(cv::Mat const &limg, cv::Mat const &rimg, int const &wr,
+               int const &d, cv::Rect const &roi, cv::Mat &cost);
+
+/* Window sums of products `L(y, x) * R(y, x - d)` for a single disparity,
+ * i.e. the cross term of normalized cross correlation, over the pixels of
+ * `roi` only.  Blocks are treated the same way as in `sad_block()`.
+ */
+void xcorr_block(cv::Mat const &limg, cv::Mat const &rimg, int const &wr,
+                 int const &d, cv::Rect const &roi, cv::Mat &cost);
+
+/* Window sums and window sums of squares of a single image.
+ * @param `img` Grayscale (CV_8UC1) image.
+ * @param `wr` Window radius, windows are the same as in `sad_slice()`.
+ * @param `sum`, `sqsum` Output CV_64FC1 images, pixels whose window does not
+ *        fit in the image are set to 0.
+ */
+void box_stats(cv::Mat const &img, int const &wr, cv::Mat &sum,
+               cv::Mat &sqsum);
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 10:12 [CST]
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "globla.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/* Matching costs of every pixel at every disparity.
+ *
+ * Costs are stored contiguously as [y][x][d], i.e. the costs of one pixel
+ * are adjacent, which is also the layout expected by
+ * `GCoptimization::setDataCost(EnergyTermType *)` on a grid graph.
+ * Costs are normalized to [0, 1] by the matcher and quantized to
+ * [0, `max_cost()`], disparities that cannot be evaluated (the window does
+ * not fit, or the cost is undefined) are set to `max_cost()`.
+ * @param `T` Cost type, one of `uint8_t`, `uint16_t` and `float`.
+ */
+template <typename T> struct CostVolume {
+    static_assert(std::is_same<T, uint8_t>::value ||
+                      std::is_same<T, uint16_t>::value ||
+                      std::is_same<T, float>::value,
+                  "Cost type must be one of uint8_t, uint16_t and float");
+
+    CostVolume() : rows(0), cols(0), ndisp(0) {}
+    CostVolume(int const &rows, int const &cols, int const &ndisp) {
+        create(rows, cols, ndisp);
+    }
+
+    int            rows, cols, ndisp;
+    std::vector<T> data;
+
+    /* (Re)allocates the volume, every cost is reset to `max_cost()` */
+    void create(int const &rows, int const &cols, int const &ndisp) {
+        this->rows  = rows;
+        this->cols  = cols;
+        this->ndisp = ndisp;
+        data.assign(std::size_t(rows) * cols * ndisp, max_cost());
+    }
+
+    /* Costs of pixel (y, x), indexed by disparity */
+    T *at(int const &y, int const &x) {
+        return data.data() + (std::size_t(y) * cols + x) * ndisp;
+    }
+    T const *at(int const &y, int const &x) const {
+        return data.data() + (std::size_t(y) * cols + x) * ndisp;
+    }
+    T &operator()(int const &y, int const &x, int const &d) {
+        return at(y, x)[d];
+    }
+    T const &operator()(int const &y, int const &x, int const &d) const {
+        return at(y, x)[d];
+    }
+
+    /* Factor from the [0, 255] range to the range of `T` */
+    static constexpr flt scale() {
+        return std::is_same<T, uint16_t>::value ? 257 : 1;
+    }
+    static constexpr T max_cost() { return T(255 * scale()); }
+    /* Quantizes a normalized cost `c` in [0, 1], NaN maps to `max_cost()` */
+    static T quantize(flt const &c) {
+        if (std::isnan(c)) {
+            return max_cost();
+        }
+        flt v = std::min<flt>(std::max<flt>(c, 0), 1) * max_cost();
+        return std::is_floating_point<T>::value ? T(v) : T(v + 0.5);
+    }
+};
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 15:40 [CST]
@@ -1,6 +1,9 @@
 #include "GCoptimization.h"
+#include "costs.hpp"
 #include "estimating.hpp"
+#include "simd.hpp"
 
+#include <algorithm>
 #include <cmath>
 
 #include <omp.h>
@@ -45,68 +48,321 @@ void pose_estimation(std::vector<cv::KeyPoint> const &kp1,
     }
 }
 
+/* Sets Pott's model smoothness costs on `graph` with the given weight, runs
+ * alpha-expansion and reads back the labeling as a CV_32SC1 image.
+ * @param `verbose` Whether to report the energy before and after.
+ * @param `dynamic` Whether to keep the graph of every label across cycles,
+ *        see `GCoptimization::setDynamicExpansion()`.
+ */
+static cv::Mat expand(GCoptimizationGridGraph *graph, int const &rows,
+                      int const &cols,
+                      GCoptimization::EnergyTermType const &potts,
+                      int const &max_iter, bool const &verbose = true,
+                      bool const &dynamic = false) {
+    /* Set smoothness cost, the model is computed on the fly rather than
+     * looked up in a table with one entry per pair of labels.
+     */
+    // graph->setSmoothCost(
+    //     GCoptimization::SmoothCostTruncatedQuadratic(1, 4));
+    graph->setSmoothCost(GCoptimization::SmoothCostPotts(potts));
+
+    graph->setDynamicExpansion(dynamic);
+
+    if (verbose) {
+        vprintf("Initial energy in graph is %lld, starting optimization via "
+                "graph cuts ..\n",
+                graph->compute_energy());
+    }
+    graph->expansion(max_iter);
+    if (verbose) {
+        vprintf("Done, energy after convergence is %lld\n",
+                graph->compute_energy());
+    }
+
+    cv::Mat ret(rows, cols, CV_32SC1);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            ret.at<int>(y, x) = graph->whatLabel(y * cols + x);
+        }
+    }
+    return ret;
+}
+
 cv::Mat global_optimization(cv::Mat const &data, MiscConf const &conf,
                             int const &max_iter) {
     if (data.type() != CV_32SC1) {
         eprintf("Expected disparity map type is CV_32SC1 (%d), got %d\n",
-                data.type());
+                CV_32SC1, data.type());
     }
     int       rows              = data.rows;
     int       cols              = data.cols;
     int       n_labels          = conf.ndisp == 0 ? cols : conf.ndisp;
     int const default_data_cost = 10;
 
+    /* Set data cost, the array is filled in place rather than through
+     * per-entry `setDataCost()` calls.  `setDataCost()` does not copy the
+     * array, so it has to outlive the graph.
+     */
+    std::vector<GCoptimization::EnergyTermType> cost(std::size_t(rows) *
+                                                     cols * n_labels);
+#pragma omp parallel for
+    for (int y = 0; y < rows; ++y) {
+        int const *label = data.ptr<int>(y);
+        for (int x = 0; x < cols; ++x) {
+            GCoptimization::EnergyTermType *c =
+                cost.data() + (std::size_t(y) * cols + x) * n_labels;
+            for (int l = 0; l < n_labels; ++l) {
+                c[l] = l == label[x] ? 0 : default_data_cost;
+            }
+        }
+    }
+
     try {
         vprintf("Initializing graph ..\n");
         GCoptimizationGridGraph *graph =
             new GCoptimizationGridGraph(cols, rows, n_labels);
         graph->setVerbosity(1);
+        graph->setDataCost(cost.data());
 
-        /* Set data cost */
-        for (int y = 0; y < rows; ++y) {
-            for (int x = 0; x < cols; ++x) {
-                int idx = y * cols + x;
-                for (int l = 0; l < n_labels; ++l) {
-                    if (l == data.at<int>(y, x)) {
-                        graph->setDataCost(idx, l, 0);
-                    } else {
-                        graph->setDataCost(idx, l, default_data_cost);
-                    }
-                }
+        cv::Mat ret = expand(graph, rows, cols, 15, max_iter);
+        delete graph;
+        return ret;
+    } catch (GCException e) {
+        e.Report();
+        eprintf("Error encountered\n");
+    }
+    return cv::Mat();
+}
+
+/* Sets the `k` cheapest labels of every pixel in rows [`r0`, `r1`) of
+ * `volume` as sparse data costs on `graph`, every other label is
+ * infeasible.  The labeling starts from the cheapest label of every site,
+ * so that it is feasible.
+ */
+template <typename T>
+static void set_sparse_costs(GCoptimization *graph,
+                             CostVolume<T> const &volume,
+                             GCoptimization::EnergyTermType const &cap,
+                             int const &k, int const &r0, int const &r1) {
+    using SparseDataCost = GCoptimization::SparseDataCost;
+    int      n_sites  = (r1 - r0) * volume.cols;
+    int      n_labels = volume.ndisp;
+    T const *base     = volume.at(r0, 0);
+
+    /* [Selection] */
+    std::vector<GCoptimization::LabelID> best(std::size_t(n_sites) * k);
+#pragma omp parallel
+    {
+        std::vector<GCoptimization::LabelID> order(n_labels);
+#pragma omp for
+        for (int s = 0; s < n_sites; ++s) {
+            T const *cost = base + std::size_t(s) * n_labels;
+            for (int l = 0; l < n_labels; ++l) {
+                order[l] = l;
             }
+            /* Ties go to the smaller disparity */
+            auto cheaper = [&](int const &a, int const &b) {
+                return cost[a] < cost[b] || (cost[a] == cost[b] && a < b);
+            };
+            std::nth_element(order.begin(), order.begin() + k, order.end(),
+                             cheaper);
+            std::sort(order.begin(), order.begin() + k, cheaper);
+            std::copy(order.begin(), order.begin() + k,
+                      best.begin() + std::size_t(s) * k);
         }
-        /* Set smoothness cost */
-        for (int l0 = 0; l0 < n_labels; ++l0) {
-            for (int l1 = 0; l1 < n_labels; ++l1) {
-                // graph->setSmoothCost(l0, l1, std::min(sq(l0 - l1), 4));
-                /* Pott's model */
-                int cost = 15 * (l0 != l1);
-                graph->setSmoothCost(l0, l1, cost);
+    }
+    /* [/Selection] */
+
+    /* [Bucketing] */
+    /* Costs are grouped by label, sites stay in increasing order within a
+     * label as the library requires.  The library copies them, so the
+     * buffer is freed before optimization.
+     */
+    std::vector<std::size_t> offset(n_labels + 1, 0);
+    for (GCoptimization::LabelID const &l : best) {
+        ++offset[l + 1];
+    }
+    for (int l = 0; l < n_labels; ++l) {
+        offset[l + 1] += offset[l];
+    }
+    std::vector<SparseDataCost> costs(best.size());
+    std::vector<std::size_t>    next(offset.begin(), offset.end() - 1);
+    for (int s = 0; s < n_sites; ++s) {
+        T const *cost = base + std::size_t(s) * n_labels;
+        graph->setLabel(s, best[std::size_t(s) * k]);
+        for (int i = 0; i < k; ++i) {
+            int l            = best[std::size_t(s) * k + i];
+            costs[next[l]++] = {
+                s,
+                std::min<GCoptimization::EnergyTermType>(
+                    std::lround(cost[l]), cap),
+            };
+        }
+    }
+    best = {};
+    for (int l = 0; l < n_labels; ++l) {
+        if (offset[l + 1] > offset[l]) {
+            graph->setDataCost(l, costs.data() + offset[l],
+                               offset[l + 1] - offset[l]);
+        }
+    }
+    /* [/Bucketing] */
+}
+
+template <typename T>
+cv::Mat global_optimization(CostVolume<T> const &volume,
+                            MiscConf const &conf, int const &max_iter,
+                            flt const &truncation, int const &topk,
+                            int const &strips, bool const &dynamic,
+                            bool const &push_relabel) {
+    int rows     = volume.rows;
+    int cols     = volume.cols;
+    int n_labels = conf.ndisp == 0 ? cols : conf.ndisp;
+    if (volume.ndisp != n_labels) {
+        eprintf("Expected %d disparities in cost volume, got %d\n", n_labels,
+                volume.ndisp);
+    }
+
+    bool sparse = 0 < topk && topk < n_labels;
+    GCoptimization::EnergyTermType cap =
+        std::lround(truncation * CostVolume<T>::max_cost());
+    /* The volume already has the [site][label] layout of a data cost array,
+     * only the cost type differs.  `setDataCost()` does not copy the array,
+     * so it has to outlive the graph.
+     */
+    std::vector<GCoptimization::EnergyTermType> data;
+    if (!sparse) {
+        data.resize(volume.data.size());
+#pragma omp parallel for
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            data[i] = std::min<GCoptimization::EnergyTermType>(
+                std::lround(volume.data[i]), cap);
+        }
+    }
+    /* Keep the smoothness weight relative to the range of the costs */
+    GCoptimization::EnergyTermType potts =
+        std::lround(15 * CostVolume<T>::scale());
+
+    cv::Mat labels(rows, cols, CV_32SC1);
+    /* Solves rows [`r0`, `r1`) as a graph of their own, starting from the
+     * labels in `init` if given, and keeps rows [`k0`, `k1`) of the result.
+     */
+    auto solve = [&](int const &r0, int const &r1, int const &k0,
+                     int const &k1, cv::Mat const *init,
+                     bool const &verbose) {
+        int                      n     = r1 - r0;
+        GCoptimizationGridGraph *graph =
+            new GCoptimizationGridGraph(cols, n, n_labels);
+        graph->setVerbosity(verbose);
+        if (push_relabel) {
+            graph->setMaxflowAlgorithm(
+                GCoptimization::GridEnergyT::PUSH_RELABEL);
+        }
+        if (sparse) {
+            set_sparse_costs(graph, volume, cap, topk, r0, r1);
+        } else {
+            graph->setDataCost(data.data() +
+                               std::size_t(r0) * cols * n_labels);
+        }
+        if (init != nullptr) {
+            for (int y = r0; y < r1; ++y) {
+                int const *row = init->ptr<int>(y);
+                for (int x = 0; x < cols; ++x) {
+                    graph->setLabel((y - r0) * cols + x, row[x]);
+                }
             }
         }
+        cv::Mat ret =
+            expand(graph, n, cols, potts, max_iter, verbose, dynamic);
+        delete graph;
+        cv::Mat kept = labels.rowRange(k0, k1);
+        ret.rowRange(k0 - r0, k1 - r0).copyTo(kept);
+    };
 
-        vprintf("Initial energy in graph is %d, starting optimization via "
-                "graph cuts ..\n",
-                graph->compute_energy());
-        graph->expansion(max_iter);
-        vprintf("Done, energy after convergence is %d\n",
-                graph->compute_energy());
+    /* Strips thinner than this have too little context to be worth it */
+    int const min_height = 64;
+    int       n_strips   = strips > 0 ? strips : omp_get_max_threads();
+    n_strips             = std::max(1, std::min(n_strips, rows / min_height));
+    if (n_strips == 1) {
+        try {
+            vprintf("Initializing graph ..\n");
+            solve(0, rows, 0, rows, nullptr, true);
+        } catch (GCException e) {
+            e.Report();
+            eprintf("Error encountered\n");
+        }
+        return labels;
+    }
 
-        cv::Mat ret(rows, cols, CV_32SC1);
-        for (int y = 0; y < rows; ++y) {
-            for (int x = 0; x < cols; ++x) {
-                ret.at<int>(y, x) = graph->whatLabel(y * cols + x);
+    /* [Strips] */
+    /* Every strip is solved with `halo` extra rows on both sides, so that
+     * the rows it keeps see their neighbors.  The second pass reconciles the
+     * seams of the first one: its strips are shifted by half a strip and
+     * start from the labels of the first pass.
+     */
+    int h    = (rows + n_strips - 1) / n_strips;
+    int halo = std::min(16, h / 2);
+    vprintf("Optimizing %d strips of %d rows in parallel via graph cuts ..\n",
+            n_strips, h);
+    for (int pass = 0; pass < 2; ++pass) {
+        int     shift = pass == 0 ? 0 : h / 2;
+        cv::Mat init  = pass == 0 ? cv::Mat() : labels.clone();
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i <= n_strips; ++i) {
+            int k0 = std::min(std::max(i * h - shift, 0), rows);
+            int k1 = std::min(std::max((i + 1) * h - shift, 0), rows);
+            if (k0 >= k1) {
+                continue;
+            }
+            int r0 = std::max(k0 - halo, 0);
+            int r1 = std::min(k1 + halo, rows);
+            try {
+                solve(r0, r1, k0, k1, pass == 0 ? nullptr : &init, false);
+            } catch (GCException e) {
+                e.Report();
+                eprintf("Error encountered\n");
             }
         }
-        return ret;
-    } catch (GCException e) {
-        e.Report();
-        eprintf("Error encountered\n");
     }
+    vprintf("Done\n");
+    /* [/Strips] */
+    return labels;
 }
 
-cv::Mat SAD(cv::Mat const &left_image, cv::Mat const &right_image,
-            int const &wr, MiscConf const &conf) {
+/* Calls `f(roi)` for every tile of size `tile` covering an image of size
+ * `rows` x `cols`.  Tiles are handed out to threads dynamically, so that
+ * tiles with more work do not stall the others.
+ * @param `title` Title of the progress bar, or `nullptr` for none.
+ */
+template <typename F>
+static void for_each_tile(int const &rows, int const &cols,
+                          cv::Size const &tile, char const *title,
+                          F const &f) {
+    if (tile.width <= 0 || tile.height <= 0) {
+        eprintf("Expected a positive tile size, got %dx%d\n", tile.width,
+                tile.height);
+    }
+    int      ty = (rows + tile.height - 1) / tile.height;
+    int      tx = (cols + tile.width - 1) / tile.width;
+    progress p(ty * tx, title ? title : "");
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < ty * tx; ++t) {
+        int x0 = t % tx * tile.width;
+        int y0 = t / tx * tile.height;
+        f(cv::Rect(x0, y0, std::min(tile.width, cols - x0),
+                   std::min(tile.height, rows - y0)));
+        if (title) {
+#pragma omp critical
+            p.advance();
+        }
+    }
+}
+
+template <typename T>
+static cv::Mat SAD(cv::Mat const &left_image, cv::Mat const &right_image,
+                   int const &wr, MiscConf const &conf,
+                   cv::Size const &tile, char const *title,
+                   CostVolume<T> *volume) {
     if (left_image.rows != right_image.rows || //
         left_image.cols != right_image.cols) {
         eprintf("Two input images has different sizes\n");
@@ -120,50 +376,209 @@ cv::Mat SAD(cv::Mat const &left_image, cv::Mat const &right_image,
     cv::cvtColor(left_image, limg, cv::COLOR_BGR2GRAY);
     cv::cvtColor(right_image, rimg, cv::COLOR_BGR2GRAY);
 
-    progress p(rows - wr * 2, "SAD");
-    /* For every pixel on the left image .. */
-#pragma omp parallel for
-    for (int y = wr; y < rows - wr; ++y) {
-        for (int x = wr + conf.ndisp; x < cols - wr; ++x) {
-            /* Find the corresponding window that has minimal difference with
-             * it on the right image.
-             */
-            uint32_t min_diff = std::numeric_limits<uint32_t>::max();
-            int      pos      = -1;
-            /* Iterate through the same row */
-            // for (int rx = wr; rx < cols - wr; ++rx) {
-            int ndisp = conf.ndisp == 0 ? cols : conf.ndisp;
+    int ndisp = conf.ndisp == 0 ? cols : conf.ndisp;
+    if (volume) {
+        volume->create(rows, cols, ndisp);
+    }
+    /* Largest possible SAD of a window, normalizes costs to [0, 1] */
+    flt const max_diff = 255.0 * sq(2 * wr);
+    /* Pixels searching the whole disparity range */
+    int const xlo = wr + conf.ndisp;
+    int const xhi = cols - wr;
+
+    /* Every tile scans all disparities before moving on, so that the strips
+     * of both images it reads stay in cache, and keeps the disparity with
+     * minimal difference for each of its pixels.
+     */
+    simd::dispatch([&](auto isa) {
+        for_each_tile(rows, cols, tile, title, [&](cv::Rect const &roi) {
+            /* Minimal SAD found so far for every pixel of the tile */
+            cv::Mat min_diff(roi.height, roi.width, CV_32SC1);
+            min_diff = std::numeric_limits<int>::max();
+            cv::Mat cur_diff;
+
+            int x0 = std::max(roi.x, xlo);
+            int x1 = std::min(roi.x + roi.width, xhi);
             for (int d = 0; d < ndisp; ++d) {
-                int rx = x - d;
-                if (rx < 0) {
-                    break;
+                sad_block(limg, rimg, wr, d, roi, cur_diff);
+                for (int y = 0; y < roi.height; ++y) {
+                    int const *diff = cur_diff.ptr<int>(y);
+                    if (x0 < x1) {
+                        decltype(isa)::argmin_update(
+                            diff + x0 - roi.x,
+                            min_diff.ptr<int>(y) + x0 - roi.x,
+                            disparity.ptr<int>(roi.y + y) + x0, x1 - x0, d);
+                    }
+                    if (volume) {
+                        for (int x = std::max(roi.x, wr + d); x < x1; ++x) {
+                            (*volume)(roi.y + y, x, d) =
+                                CostVolume<T>::quantize(diff[x - roi.x] /
+                                                        max_diff);
+                        }
+                    }
                 }
+            }
+        });
+    });
+
+    return disparity;
+}
+
+cv::Mat SAD(cv::Mat const &left_image, cv::Mat const &right_image,
+            int const &wr, MiscConf const &conf, cv::Size const &tile,
+            char const *title) {
+    return SAD<uint8_t>(left_image, right_image, wr, conf, tile, title,
+                        nullptr);
+}
+
+template <typename T>
+cv::Mat SAD(cv::Mat const &left_image, cv::Mat const &right_image,
+            int const &wr, MiscConf const &conf, CostVolume<T> &volume,
+            cv::Size const &tile) {
+    return SAD(left_image, right_image, wr, conf, tile, "SAD", &volume);
+}
+
+/* Matches one pyramid level, searching disparities [lo(y, x), hi(y, x)]
+ * of every pixel.  Every tile evaluates the union of the ranges of its
+ * pixels, small tiles keep the unions tight.
+ * @return Disparity map, -1 where no disparity could be evaluated.
+ */
+static cv::Mat match_level(cv::Mat const &limg, cv::Mat const &rimg,
+                           int const &wr, cv::Mat const &lo,
+                           cv::Mat const &hi) {
+    int     rows = limg.rows;
+    int     cols = limg.cols;
+    cv::Mat disparity(rows, cols, CV_32SC1);
+    disparity = -1;
+
+    auto match_tile = [&](cv::Rect const &roi) {
+        int x0  = roi.x;
+        int y0  = roi.y;
+        int dlo = std::numeric_limits<int>::max();
+        int dhi = std::numeric_limits<int>::min();
+        for (int y = y0; y < y0 + roi.height; ++y) {
+            for (int x = x0; x < x0 + roi.width; ++x) {
+                dlo = std::min(dlo, lo.at<int>(y, x));
+                dhi = std::max(dhi, hi.at<int>(y, x));
+            }
+        }
 
-                uint32_t cur_diff = 0;
-                for (int i = -wr; i < wr; ++i) {
-                    for (int j = -wr; j < wr; ++j) {
-                        int lcol = limg.at<uint8_t>(y + j, x + i);
-                        int rcol = rimg.at<uint8_t>(y + j, rx + i);
-                        cur_diff += std::abs(lcol - rcol);
+        /* Minimal SAD found so far for every pixel of the tile */
+        std::vector<int> min_diff(roi.width * roi.height,
+                                  std::numeric_limits<int>::max());
+        cv::Mat          cur_diff;
+        for (int d = dlo; d <= dhi; ++d) {
+            sad_block(limg, rimg, wr, d, roi, cur_diff);
+            for (int y = 0; y < roi.height; ++y) {
+                int const *diff = cur_diff.ptr<int>(y);
+                int const *l    = lo.ptr<int>(y0 + y) + x0;
+                int const *h    = hi.ptr<int>(y0 + y) + x0;
+                int *      best = min_diff.data() + y * roi.width;
+                int *      disp = disparity.ptr<int>(y0 + y) + x0;
+                for (int x = 0; x < roi.width; ++x) {
+                    if (l[x] <= d && d <= h[x] && best[x] > diff[x]) {
+                        best[x] = diff[x];
+                        disp[x] = d;
                     }
                 }
-                if (min_diff > cur_diff) {
-                    min_diff = cur_diff;
-                    pos      = rx;
+            }
+        }
+    };
+    for_each_tile(rows, cols, cv::Size(32, 32), nullptr, match_tile);
+    return disparity;
+}
+
+cv::Mat SAD_pyramid(cv::Mat const &left_image, cv::Mat const &right_image,
+                    int const &wr, MiscConf const &conf, int const &levels,
+                    int const &radius) {
+    if (left_image.rows != right_image.rows || //
+        left_image.cols != right_image.cols) {
+        eprintf("Two input images has different sizes\n");
+    }
+    if (levels < 1 || radius < 0) {
+        eprintf("Expected at least 1 level and a non-negative radius, got "
+                "%d and %d\n",
+                levels, radius);
+    }
+    int ndisp = conf.ndisp == 0 ? left_image.cols : conf.ndisp;
+
+    /* Gaussian pyramids of both images, level k has 1/2^k resolution */
+    std::vector<cv::Mat> lpyr(levels), rpyr(levels);
+    cv::cvtColor(left_image, lpyr[0], cv::COLOR_BGR2GRAY);
+    cv::cvtColor(right_image, rpyr[0], cv::COLOR_BGR2GRAY);
+    for (int k = 1; k < levels; ++k) {
+        cv::pyrDown(lpyr[k - 1], lpyr[k]);
+        cv::pyrDown(rpyr[k - 1], rpyr[k]);
+    }
+
+    cv::Mat  disparity;
+    progress p(levels, "SAD pyramid");
+    for (int k = levels - 1; k >= 0; --k) {
+        int     rows   = lpyr[k].rows;
+        int     cols   = lpyr[k].cols;
+        int     kndisp = (ndisp + (1 << k) - 1) >> k;
+        cv::Mat lo(rows, cols, CV_32SC1), hi(rows, cols, CV_32SC1);
+        if (k == levels - 1) {
+            lo = 0;
+            hi = kndisp - 1;
+        } else {
+            /* Search around twice the coarser disparities that bilinear
+             * upsampling would blend, so that both sides of a depth edge
+             * are covered.  Lookups are clamped to coarse pixels whose
+             * window fits, and the whole range is searched where any of
+             * them is still unknown.
+             */
+            cv::Mat const &coarse = disparity;
+            auto           clamp  = [&](int const &v, int const &n) {
+                return std::max(wr, std::min(v, n - wr - 1));
+            };
+#pragma omp parallel for
+            for (int y = 0; y < rows; ++y) {
+                int cy0 = clamp(y / 2, coarse.rows);
+                int cy1 = clamp(y / 2 + 1, coarse.rows);
+                for (int x = 0; x < cols; ++x) {
+                    int cx0 = clamp(x / 2, coarse.cols);
+                    int cx1 = clamp(x / 2 + 1, coarse.cols);
+                    int dmin =
+                        std::min(std::min(coarse.at<int>(cy0, cx0),
+                                          coarse.at<int>(cy0, cx1)),
+                                 std::min(coarse.at<int>(cy1, cx0),
+                                          coarse.at<int>(cy1, cx1)));
+                    int dmax =
+                        std::max(std::max(coarse.at<int>(cy0, cx0),
+                                          coarse.at<int>(cy0, cx1)),
+                                 std::max(coarse.at<int>(cy1, cx0),
+                                          coarse.at<int>(cy1, cx1)));
+                    if (dmin < 0) {
+                        lo.at<int>(y, x) = 0;
+                        hi.at<int>(y, x) = kndisp - 1;
+                    } else {
+                        lo.at<int>(y, x) = std::max(2 * dmin - radius, 0);
+                        hi.at<int>(y, x) =
+                            std::min(2 * dmax + radius, kndisp - 1);
+                    }
                 }
             }
-            // vprintf("disparity = %d\n", std::abs(pos - x));
-            flt d                   = std::abs(x - pos);
-            disparity.at<int>(y, x) = d;
         }
+        disparity = match_level(lpyr[k], rpyr[k], wr, lo, hi);
         p.advance();
     }
 
+    /* Pixels without any evaluated disparity default to 0 as in `SAD()` */
+#pragma omp parallel for
+    for (int y = 0; y < disparity.rows; ++y) {
+        int *disp = disparity.ptr<int>(y);
+        for (int x = 0; x < disparity.cols; ++x) {
+            disp[x] = std::max(disp[x], 0);
+        }
+    }
     return disparity;
 }
 
-cv::Mat NCC(cv::Mat const &left_image, cv::Mat const &right_image,
-            int const &wr, MiscConf const &conf) {
+template <typename T>
+static cv::Mat NCC(cv::Mat const &left_image, cv::Mat const &right_image,
+                   int const &wr, MiscConf const &conf,
+                   cv::Size const &tile, CostVolume<T> *volume) {
     if (left_image.rows != right_image.rows || //
         left_image.cols != right_image.cols) {
         eprintf("Two input images has different sizes\n");
@@ -177,59 +592,104 @@ cv::Mat NCC(cv::Mat const &left_image, cv::Mat const &right_image,
     cv::cvtColor(left_image, limg, cv::COLOR_BGR2GRAY);
     cv::cvtColor(right_image, rimg, cv::COLOR_BGR2GRAY);
 
-    progress p(rows - wr * 2, "NCC");
-#pragma omp parallel for
-    for (int y = wr; y < rows - wr; ++y) {
-        for (int x = wr + conf.ndisp; x < cols - wr; ++x) {
-            int pos      = -1;
-            flt max_corr = std::numeric_limits<flt>::lowest();
+    /* Window statistics do not depend on disparity, compute them once */
+    cv::Mat lsum, lsqsum, rsum, rsqsum;
+    box_stats(limg, wr, lsum, lsqsum);
+    box_stats(rimg, wr, rsum, rsqsum);
 
-            int ndisp = conf.ndisp == 0 ? cols : conf.ndisp;
-            for (int d = 0; d < ndisp; ++d) {
-                int rx = x - d;
-                if (rx < 0) {
-                    break;
-                }
+    /* Number of pixels in a window, and the divisor used for window means */
+    flt const n = sq(2 * wr);
+    flt const m = sq(2 * wr + 1);
 
-                flt lavg = 0;
-                flt ravg = 0;
-                for (int i = -wr; i < wr; ++i) {
-                    for (int j = -wr; j < wr; ++j) {
-                        lavg += limg.at<uint8_t>(y + j, x + i);
-                        ravg += rimg.at<uint8_t>(y + j, rx + i);
+    int ndisp = conf.ndisp == 0 ? cols : conf.ndisp;
+    if (volume) {
+        volume->create(rows, cols, ndisp);
+    }
+    /* Pixels searching the whole disparity range, every pixel whose window
+     * fits is evaluated when a cost volume is requested.
+     */
+    int const xlo = wr + conf.ndisp;
+
+    /* Tiles are traversed the same way as in `SAD()` */
+    for_each_tile(rows, cols, tile, "NCC", [&](cv::Rect const &roi) {
+        /* Maximal correlation found so far for every pixel of the tile */
+        cv::Mat max_corr(roi.height, roi.width, CV_64FC1);
+        max_corr = std::numeric_limits<flt>::lowest();
+        cv::Mat cross;
+
+        int y0 = std::max(roi.y, wr);
+        int y1 = std::min(roi.y + roi.height, rows - wr);
+        int x1 = std::min(roi.x + roi.width, cols - wr);
+        for (int d = 0; d < ndisp; ++d) {
+            xcorr_block(limg, rimg, wr, d, roi, cross);
+            int x0 = std::max(roi.x, volume ? wr + d : std::max(xlo, wr + d));
+            for (int y = y0; y < y1; ++y) {
+                flt const *ls   = lsum.ptr<flt>(y);
+                flt const *lss  = lsqsum.ptr<flt>(y);
+                flt const *rs   = rsum.ptr<flt>(y);
+                flt const *rss  = rsqsum.ptr<flt>(y);
+                int const *lr   = cross.ptr<int>(y - roi.y);
+                flt *      best = max_corr.ptr<flt>(y - roi.y);
+                int *      disp = disparity.ptr<int>(y);
+                for (int x = x0; x < x1; ++x) {
+                    int rx = x - d;
+                    int tx = x - roi.x;
+                    /* Expansions of sum((l - lavg) * (r - ravg)), sum((l -
+                     * lavg)^2) and sum((r - ravg)^2) over the window.
+                     */
+                    flt lavg     = ls[x] / m;
+                    flt ravg     = rs[rx] / m;
+                    flt cur_corr = lr[tx] - lavg * rs[rx] - ravg * ls[x] +
+                                   n * lavg * ravg;
+                    flt lstd = lss[x] - 2 * lavg * ls[x] + n * sq(lavg);
+                    flt rstd = rss[rx] - 2 * ravg * rs[rx] + n * sq(ravg);
+                    cur_corr /= std::sqrt(lstd * rstd);
+
+                    if (volume) {
+                        (*volume)(y, x, d) =
+                            CostVolume<T>::quantize((1 - cur_corr) / 2);
                     }
-                }
-                lavg /= sq(2 * wr + 1);
-                ravg /= sq(2 * wr + 1);
-
-                flt cur_corr = 0;
-                flt lstd     = 0;
-                flt rstd     = 0;
-                for (int i = -wr; i < wr; ++i) {
-                    for (int j = -wr; j < wr; ++j) {
-                        flt lcol = limg.at<uint8_t>(y + j, x + i);
-                        flt rcol = rimg.at<uint8_t>(y + j, rx + i);
-                        cur_corr += (lcol - lavg) * (rcol - ravg);
-                        lstd += sq(lcol - lavg);
-                        rstd += sq(rcol - ravg);
+                    if (x >= xlo && best[tx] < cur_corr) {
+                        best[tx] = cur_corr;
+                        disp[x]  = d;
                     }
                 }
-                cur_corr /= std::sqrt(lstd * rstd);
-
-                if (max_corr < cur_corr) {
-                    max_corr = cur_corr;
-                    pos      = rx;
-                }
             }
-            // vprintf("disparity = %d\n", std::abs(pos - x));
-            flt d                   = std::abs(x - pos);
-            disparity.at<int>(y, x) = d;
         }
-        p.advance();
-    }
+    });
 
     return disparity;
 }
 
+cv::Mat NCC(cv::Mat const &left_image, cv::Mat const &right_image,
+            int const &wr, MiscConf const &conf, cv::Size const &tile) {
+    return NCC<uint8_t>(left_image, right_image, wr, conf, tile, nullptr);
+}
+
+template <typename T>
+cv::Mat NCC(cv::Mat const &left_image, cv::Mat const &right_image,
+            int const &wr, MiscConf const &conf, CostVolume<T> &volume,
+            cv::Size const &tile) {
+    return NCC(left_image, right_image, wr, conf, tile, &volume);
+}
+
+/* Explicit instantiations for the supported cost types */
+#define INSTANTIATE(T)                                                       \
+    template cv::Mat global_optimization(CostVolume<T> const &,              \
+                                         MiscConf const &, int const &,      \
+                                         flt const &, int const &,           \
+                                         int const &, bool const &,          \
+                                         bool const &);                      \
+    template cv::Mat SAD(cv::Mat const &, cv::Mat const &, int const &,      \
+                         MiscConf const &, CostVolume<T> &,                  \
+                         cv::Size const &);                                  \
+    template cv::Mat NCC(cv::Mat const &, cv::Mat const &, int const &,      \
+                         MiscConf const &, CostVolume<T> &,                  \
+                         cv::Size const &);
+INSTANTIATE(uint8_t)
+INSTANTIATE(uint16_t)
+INSTANTIATE(float)
+#undef INSTANTIATE
+
 // Author: Blurgy <gy@blurgy.xyz>
 // Date:   Feb 27 2021, 17:21 [CST]
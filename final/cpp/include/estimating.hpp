@@ -1,5 +1,6 @@
 #pragma once
 
+#include "costvolume.hpp"
 #include "globla.hpp"
 
 void pose_estimation(std::vector<cv::KeyPoint> const &kp1,
@@ -15,6 +16,46 @@ void pose_estimation(std::vector<cv::KeyPoint> const &kp1,
  */
 cv::Mat global_optimization(cv::Mat const &data, MiscConf const &conf,
                             int const &max_iter = 6);
+/* Disparity estimation via graph-cuts method, using the matching costs in
+ * `volume` as data costs.
+ * @param `volume` Cost volume filled by `SAD()` or `NCC()`, its number of
+ *        disparities must match `conf.ndisp`.
+ * @param `conf` Configs.
+ * @param `max_iter` Same as above.
+ * @param `truncation` Data costs are capped at this fraction of the cost
+ *        range, so that occluded pixels do not dominate the energy.
+ *        Default value is `1` (no truncation).
+ * @param `topk` Only keep the `topk` cheapest disparities of every pixel as
+ *        sparse data costs, bounding the memory of the graph by `topk`
+ *        instead of the number of disparities.  Default value is `0` (keep
+ *        all of them).
+ * @param `strips` Number of horizontal strips optimized in parallel, seams
+ *        are reconciled by a second pass over shifted strips.  Default
+ *        value is `1` (the whole image as a single graph), `0` uses one
+ *        strip per OpenMP thread, which makes the result depend on the
+ *        number of threads.
+ * @param `dynamic` Keep the graph of every disparity across expansion
+ *        cycles and only update the pixels that changed, which speeds up
+ *        the cycles after the first one at the cost of one graph per
+ *        disparity in memory.  Default value is `false`.
+ * @param `push_relabel` Solve every expansion move with a parallel
+ *        push-relabel instead of the sequential Boykov-Kolmogorov maxflow.
+ *        It only pays off with `strips` = `1`, when the OpenMP threads are
+ *        not already busy with strips, and is ignored with `dynamic`.
+ *        Default value is `false`, see `gc-bench` for comparing both.
+ */
+template <typename T>
+cv::Mat global_optimization(CostVolume<T> const &volume,
+                            MiscConf const &conf, int const &max_iter = 6,
+                            flt const &truncation = 1, int const &topk = 0,
+                            int const &strips = 1,
+                            bool const &dynamic      = false,
+                            bool const &push_relabel = false);
+
+/* Default tile size (width x height) of the local matchers, see
+ * `stereo-bench` for comparing tile sizes on a given machine.
+ */
+cv::Size const default_tile(128, 64);
 
 /* Sum of absolute difference (SAD).
  * @param `{l,r}img` **Rectified** stereo images.
@@ -22,10 +63,37 @@ cv::Mat global_optimization(cv::Mat const &data, MiscConf const &conf,
  * @param `fx` **Effective** focal length on `x` axis of the 2 given rectified
  *        stereo images.
  * @param `conf` Configs.
+ * @param `tile` Tile size, every tile scans all disparities at once so
+ *        that the image strips it reads stay in cache.
+ * @param `title` Title of the progress bar, or `nullptr` for none.
  * @return Disparity map estimated with minimal SAD.
  */
 cv::Mat SAD(cv::Mat const &left_image, cv::Mat const &right_image,
-            int const &wr, MiscConf const &conf);
+            int const &wr, MiscConf const &conf,
+            cv::Size const &tile = default_tile, char const *title = "SAD");
+/* Same as above, additionally fills `volume` with the mean absolute
+ * difference of every window at every disparity, normalized to [0, 1].
+ */
+template <typename T>
+cv::Mat SAD(cv::Mat const &left_image, cv::Mat const &right_image,
+            int const &wr, MiscConf const &conf, CostVolume<T> &volume,
+            cv::Size const &tile = default_tile);
+
+/* Coarse-to-fine sum of absolute difference.
+ * Matches at 1/2^(`levels` - 1) resolution over the whole disparity range
+ * first, then every finer level only searches `radius` disparities around
+ * twice the estimates of the coarser level.
+ * @param `{l,r}img` **Rectified** stereo images.
+ * @param `wr` Window radius, same as in `SAD()` at every level.
+ * @param `conf` Configs.
+ * @param `levels` Number of pyramid levels, `3` matches at 1/4, 1/2 and full
+ *        resolution.
+ * @param `radius` Search radius around the upsampled estimates.
+ * @return Disparity map estimated with minimal SAD.
+ */
+cv::Mat SAD_pyramid(cv::Mat const &left_image, cv::Mat const &right_image,
+                    int const &wr, MiscConf const &conf,
+                    int const &levels = 3, int const &radius = 2);
 
 /* Normalized cross correlation (NCC).
  * @param `{l,r}img` **Rectified** stereo images.
@@ -33,10 +101,19 @@ cv::Mat SAD(cv::Mat const &left_image, cv::Mat const &right_image,
  * @param `fx` **Effective** focal length on `x` axis of the 2 given rectified
  *        stereo images.
  * @param `conf` Configs.
+ * @param `tile` Tile size, same as in `SAD()`.
  * @return Disparity map estimated with maximum NCC.
  */
 cv::Mat NCC(cv::Mat const &left_image, cv::Mat const &right_image,
-            int const &wr, MiscConf const &conf);
+            int const &wr, MiscConf const &conf,
+            cv::Size const &tile = default_tile);
+/* Same as above, additionally fills `volume` with `(1 - ncc) / 2` of every
+ * window at every disparity.
+ */
+template <typename T>
+cv::Mat NCC(cv::Mat const &left_image, cv::Mat const &right_image,
+            int const &wr, MiscConf const &conf, CostVolume<T> &volume,
+            cv::Size const &tile = default_tile);
 
 // Author: Blurgy <gy@blurgy.xyz>
 // Date:   Feb 27 2021, 17:20 [CST]
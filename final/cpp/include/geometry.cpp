@@ -1,6 +1,11 @@
 #include "estimating.hpp"
 #include "geometry.hpp"
 
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
 SpatialPoint to_camera_space(CamConf const &conf, SpatialPoint const &point) {
     SpatialPoint ret;
     ret.pos = vec3{
@@ -33,36 +38,10 @@ CamConf get_reprojection_conf(CamConf const &from, CamConf const &to) {
     return ret;
 }
 
-std::vector<ppp> stereo_rectification(cv::Mat const &left_image,
-                                      cv::Mat const &right_image,
-                                      CamConf const &left_camera,
-                                      CamConf const &right_camera,
-                                      cv::Mat &      rectified_left_image,
-                                      cv::Mat &      rectified_right_image) {
-    std::vector<SpatialPoint> lpts, rpts;
-    std::vector<ppp>          ret;
-    /* Generate points on both images' imaging planes */
-    for (int y = 0; y < left_image.rows; ++y) {
-        cv::Vec3b const *row = left_image.ptr<cv::Vec3b>(y);
-        for (int x = 0; x < left_image.cols; ++x) {
-            lpts.push_back({
-                {x + 0.5, y + 0.5, 1},             // position
-                {row[x][0], row[x][1], row[x][2]}, // color
-            });
-        }
-    }
-    for (int y = 0; y < right_image.rows; ++y) {
-        cv::Vec3b const *row = right_image.ptr<cv::Vec3b>(y);
-        for (int x = 0; x < right_image.cols; ++x) {
-            rpts.push_back({
-                {x + 0.5, y + 0.5, 1},             // position
-                {row[x][0], row[x][1], row[x][2]}, // color
-            });
-        }
-    }
-    assert(lpts.size() == rpts.size());
-
-    int len = lpts.size();
+void rectifying_rotations(cv::Mat const &left_image,
+                          cv::Mat const &right_image,
+                          CamConf const &left_camera,
+                          CamConf const &right_camera, mat3 &R1, mat3 &R2) {
     // clang-format off
     mat3 K{
         left_camera.fx, 0, left_camera.cx,
@@ -76,7 +55,7 @@ std::vector<ppp> stereo_rectification(cv::Mat const &left_image,
     std::vector<cv::DMatch>   matches;
     get_matches(left_image, right_image, kp1, kp2, matches);
     pose_estimation(kp1, kp2, matches, K, R, t);
-    mat3 R2    = glm::transpose(R);
+    R2         = glm::transpose(R);
     vec3 trans = -t * glm::transpose(R);
 
     /* Get rectification matrix */
@@ -91,73 +70,196 @@ std::vector<ppp> stereo_rectification(cv::Mat const &left_image,
     };
     // clang-format on
 
-    R2      = R2 * R_rect;
-    mat3 R1 = R_rect;
+    R2 = R2 * R_rect;
+    R1 = R_rect;
+}
+
+/* Position of pixel center (x, y) of `camera` on the rectified imaging
+ * plane given by rotation `R`.
+ */
+static vec3 rectify_point(CamConf const &camera, mat3 const &R, flt const &x,
+                          flt const &y) {
+    SpatialPoint p = {{x, y, 1}, {}};
+    p.pos          = to_camera_space(camera, p).pos * R;
+    return to_image_space(camera, p).pos;
+}
+
+Rectification make_rectification(CamConf const &left_camera,
+                                 CamConf const &right_camera,
+                                 mat3 const &R1, mat3 const &R2,
+                                 int const &rows, int const &cols) {
+    Rectification ret;
+    ret.left  = left_camera;
+    ret.right = right_camera;
+    ret.R1    = R1;
+    ret.R2    = R2;
 
     flt maxx = std::numeric_limits<flt>::lowest();
     flt maxy = std::numeric_limits<flt>::lowest();
     flt minx = std::numeric_limits<flt>::max();
     flt miny = std::numeric_limits<flt>::max();
+    /* A homography maps the image borders to straight lines, so the bounds
+     * are reached at the corners.
+     */
+    for (flt y : {0.5, rows - 0.5}) {
+        for (flt x : {0.5, cols - 0.5}) {
+            for (vec3 p : {rectify_point(left_camera, R1, x, y),
+                           rectify_point(right_camera, R2, x, y)}) {
+                maxx = std::max(maxx, p.x);
+                minx = std::min(minx, p.x);
+                maxy = std::max(maxy, p.y);
+                miny = std::min(miny, p.y);
+            }
+        }
+    }
+    ret.offset = vec3(minx, miny, 0);
+    ret.cols   = std::round(maxx) - std::round(minx) + 1;
+    ret.rows   = std::round(maxy) - std::round(miny) + 1;
+    return ret;
+}
 
-    std::vector<SpatialPoint> limgpts, rimgpts;
-    for (int i = 0; i < len; ++i) {
-        vec3         ncoord = to_camera_space(right_camera, rpts[i]).pos * R2;
-        SpatialPoint p      = {ncoord, rpts[i].color};
-        p                   = to_image_space(right_camera, p);
-        rimgpts.push_back(p);
-
-        ncoord = to_camera_space(left_camera, lpts[i]).pos * R1;
-        p      = {ncoord, lpts[i].color};
-        p      = to_image_space(left_camera, p);
-        limgpts.push_back(p);
-
-        SpatialPoint lp = limgpts[i];
-        maxx            = std::max(maxx, lp.pos.x);
-        minx            = std::min(minx, lp.pos.x);
-        maxy            = std::max(maxy, lp.pos.y);
-        miny            = std::min(miny, lp.pos.y);
-
-        SpatialPoint rp = rimgpts[i];
-        maxx            = std::max(maxx, rp.pos.x);
-        minx            = std::min(minx, rp.pos.x);
-        maxy            = std::max(maxy, rp.pos.y);
-        miny            = std::min(miny, rp.pos.y);
+void rectification_maps(Rectification const &rect, bool const &right,
+                        int const &r0, int const &r1, cv::Mat &mapx,
+                        cv::Mat &mapy) {
+    CamConf const &camera = right ? rect.right : rect.left;
+    /* Rotations are orthonormal, the transpose undoes them */
+    mat3 const inv = glm::transpose(right ? rect.R2 : rect.R1);
+    mapx.create(r1 - r0, rect.cols, CV_32FC1);
+    mapy.create(r1 - r0, rect.cols, CV_32FC1);
+#pragma omp parallel for
+    for (int v = r0; v < r1; ++v) {
+        float *mx = mapx.ptr<float>(v - r0);
+        float *my = mapy.ptr<float>(v - r0);
+        for (int u = 0; u < rect.cols; ++u) {
+            /* Rectified pixel (u, v) is centered at (u + .5, v + .5) +
+             * offset, points land on it by flooring as in the pixel map.
+             */
+            SpatialPoint p = {
+                {u + 0.5 + rect.offset.x, v + 0.5 + rect.offset.y, 1}, {}};
+            p.pos = to_camera_space(camera, p).pos * inv;
+            if (p.pos.z <= 0) {
+                /* Behind the camera, sample outside of the image */
+                mx[u] = my[u] = -1;
+                continue;
+            }
+            p     = to_image_space(camera, p);
+            mx[u] = p.pos.x - 0.5;
+            my[u] = p.pos.y - 0.5;
+        }
     }
+}
+
+/* Remap tables of a stereo rig, they only depend on the calibration and
+ * the image size.
+ */
+struct RectificationTables {
+    CamConf          left, right;
+    int              rows, cols;
+    Rectification    rect;
+    cv::Mat          lmap1, lmap2; // Fixed-point maps of the left image
+    cv::Mat          rmap1, rmap2; // Fixed-point maps of the right image
+    PixelMap         pixel_map;    // Rectified pixel of every left pixel
+};
+
+static bool same_camera(CamConf const &a, CamConf const &b) {
+    /* CamConf is plain data without padding */
+    return std::memcmp(&a, &b, sizeof(CamConf)) == 0;
+}
 
-    int cols              = std::round(maxx) - std::round(minx) + 1;
-    int rows              = std::round(maxy) - std::round(miny) + 1;
-    rectified_left_image  = cv::Mat(rows, cols, left_image.type());
-    rectified_right_image = cv::Mat(rows, cols, right_image.type());
-
-    rectified_left_image  = 0;
-    rectified_right_image = 0;
-
-    for (int i = 0; i < len; ++i) {
-        SpatialPoint lp = limgpts[i];
-        lp.pos -= vec3(minx, miny, 0);
-        ret.push_back(std::make_pair(lpts[i], lp));
-        int lx = lp.pos.x;
-        int ly = lp.pos.y;
-        if (0 <= lx && lx < rectified_left_image.cols && //
-            0 <= ly && ly < rectified_left_image.rows) {
-            rectified_left_image.at<cv::Vec3b>(ly, lx) =
-                cv::Vec3b(lp.color[0], lp.color[1], lp.color[2]);
+static void build_tables(RectificationTables &tables) {
+    Rectification const &rect = tables.rect;
+    cv::Mat              mapx, mapy;
+    /* Fixed-point maps halve the table size and take the fast path of
+     * `cv::remap()`.
+     */
+    rectification_maps(rect, false, 0, rect.rows, mapx, mapy);
+    cv::convertMaps(mapx, mapy, tables.lmap1, tables.lmap2, CV_16SC2);
+    rectification_maps(rect, true, 0, rect.rows, mapx, mapy);
+    cv::convertMaps(mapx, mapy, tables.rmap1, tables.rmap2, CV_16SC2);
+
+    int       rows = tables.rows;
+    int       cols = tables.cols;
+    PixelMap &pmap = tables.pixel_map;
+    pmap.rect_rows = rect.rows;
+    pmap.rect_cols = rect.cols;
+    pmap.index.resize(std::size_t(rows) * cols);
+#pragma omp parallel for
+    for (int y = 0; y < rows; ++y) {
+        int32_t *index = pmap.index.data() + std::size_t(y) * cols;
+        for (int x = 0; x < cols; ++x) {
+            vec3 p = rectify_point(rect.left, rect.R1, x + 0.5, y + 0.5);
+            p -= rect.offset;
+            int rx   = std::floor(p.x);
+            int ry   = std::floor(p.y);
+            index[x] = inrange(rx, 0, rect.cols) && inrange(ry, 0, rect.rows)
+                           ? ry * rect.cols + rx
+                           : -1;
         }
+    }
+}
 
-        SpatialPoint rp = rimgpts[i];
-        rp.pos -= vec3(minx, miny, 0);
-        int rx = rp.pos.x;
-        int ry = rp.pos.y;
-        if (0 <= rx && rx < rectified_right_image.cols && //
-            0 <= ry && ry < rectified_right_image.rows) {
-            rectified_right_image.at<cv::Vec3b>(ry, rx) =
-                cv::Vec3b(rp.color[0], rp.color[1], rp.color[2]);
+PixelMap stereo_rectification(cv::Mat const &left_image,
+                              cv::Mat const &right_image,
+                              CamConf const &left_camera,
+                              CamConf const &right_camera,
+                              cv::Mat &      rectified_left_image,
+                              cv::Mat &      rectified_right_image) {
+    if (left_image.rows != right_image.rows ||
+        left_image.cols != right_image.cols) {
+        eprintf("The given 2 stereo images has different sizes\n");
+    }
+    int rows = left_image.rows;
+    int cols = left_image.cols;
+
+    /* [Cache lookup] */
+    /* Only the most recently used rigs are kept */
+    static std::size_t const capacity = 4;
+    static std::mutex        lock;
+    static std::vector<std::shared_ptr<RectificationTables>> cache;
+
+    std::shared_ptr<RectificationTables> tables;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto it = cache.begin(); it != cache.end(); ++it) {
+            if (same_camera((*it)->left, left_camera) &&
+                same_camera((*it)->right, right_camera) &&
+                (*it)->rows == rows && (*it)->cols == cols) {
+                tables = *it;
+                cache.erase(it);
+                break;
+            }
         }
     }
-    interpolate(rectified_left_image);
-    interpolate(rectified_right_image);
+    if (!tables) {
+        tables        = std::make_shared<RectificationTables>();
+        tables->left  = left_camera;
+        tables->right = right_camera;
+        tables->rows  = rows;
+        tables->cols  = cols;
+        mat3 R1, R2;
+        rectifying_rotations(left_image, right_image, left_camera,
+                             right_camera, R1, R2);
+        tables->rect = make_rectification(left_camera, right_camera, R1, R2,
+                                          rows, cols);
+        build_tables(*tables);
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        cache.push_back(tables);
+        if (cache.size() > capacity) {
+            cache.erase(cache.begin());
+        }
+    }
+    /* [/Cache lookup] */
 
-    return ret;
+    /* Pixels that see nothing of the original images are left black */
+    cv::remap(left_image, rectified_left_image, tables->lmap1, tables->lmap2,
+              cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
+    cv::remap(right_image, rectified_right_image, tables->rmap1,
+              tables->rmap2, cv::INTER_LINEAR, cv::BORDER_CONSTANT,
+              cv::Scalar(0, 0, 0));
+
+    return tables->pixel_map;
 }
 
 // Author: Blurgy <gy@blurgy.xyz>
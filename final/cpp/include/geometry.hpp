@@ -9,13 +9,54 @@ SpatialPoint to_image_space(CamConf const &conf, SpatialPoint const &point);
  */
 CamConf get_reprojection_conf(CamConf const &from, CamConf const &to);
 
-/* Stereo rectification */
-std::vector<ppp> stereo_rectification(cv::Mat const &left_image,
-                                      cv::Mat const &right_image,
-                                      CamConf const &left_camera,
-                                      CamConf const &right_camera,
-                                      cv::Mat &      rectified_left_image,
-                                      cv::Mat &      rectified_right_image);
+/* Rotations of the left (`R1`) and right (`R2`) camera spaces that make
+ * epipolar lines horizontal, estimated from feature matches between the 2
+ * images.  Camera space positions are rotated as `pos * R`.
+ */
+void rectifying_rotations(cv::Mat const &left_image,
+                          cv::Mat const &right_image,
+                          CamConf const &left_camera,
+                          CamConf const &right_camera, mat3 &R1, mat3 &R2);
+
+/* Common imaging plane of a rectified stereo pair */
+struct Rectification {
+    CamConf left, right; // Cameras of the original images
+    mat3    R1, R2;      // Rectifying rotations of both cameras
+    vec3    offset;      // Position of rectified pixel (0, 0) on the plane
+    int     rows, cols;  // Size of the rectified images
+};
+
+/* Rectification of a stereo pair of size `rows` x `cols`, the rectified
+ * images are just large enough to hold both rotated images.
+ */
+Rectification make_rectification(CamConf const &left_camera,
+                                 CamConf const &right_camera,
+                                 mat3 const &R1, mat3 const &R2,
+                                 int const &rows, int const &cols);
+
+/* Inverse maps of rectified rows [`r0`, `r1`), for `cv::remap()`.
+ * @param `right` Whether to map the right image instead of the left one.
+ * @param `map{x,y}` Output CV_32FC1 images of size (`r1` - `r0`) x
+ *        `rect.cols`, holding the source pixel coordinates of every
+ *        rectified pixel.
+ */
+void rectification_maps(Rectification const &rect, bool const &right,
+                        int const &r0, int const &r1, cv::Mat &mapx,
+                        cv::Mat &mapy);
+
+/* Stereo rectification, the rectified images are gathered from the
+ * original ones with bilinear interpolation.  Remap tables are cached per
+ * calibration and image size, so later frames of the same rig skip both
+ * pose estimation and geometry.
+ * @return Rectified pixel of every pixel of the left image, for
+ *         `map_back()`.
+ */
+PixelMap stereo_rectification(cv::Mat const &left_image,
+                              cv::Mat const &right_image,
+                              CamConf const &left_camera,
+                              CamConf const &right_camera,
+                              cv::Mat &      rectified_left_image,
+                              cv::Mat &      rectified_right_image);
 
 // Author: Blurgy <gy@blurgy.xyz>
 // Date:   Feb 27 2021, 16:19 [CST]
@@ -109,33 +109,33 @@ MiscConf read_calib(std::string const &filename) {
     return ret;
 }
 
-cv::Mat map_back(std::vector<ppp> const &pixel_map, int const &rows,
+cv::Mat map_back(PixelMap const &pixel_map, int const &rows,
                  int const &cols, cv::Mat const &disp) {
     if (disp.type() != CV_32SC1) {
         eprintf("Expected disparity map type is CV_32SC1 (%d), got %d\n",
-                disp.type());
+                CV_32SC1, disp.type());
     }
-    if (pixel_map.size() == 0) {
+    if (pixel_map.index.size() == 0) {
         return disp;
     }
-    int     drows = disp.rows;
-    int     dcols = disp.cols;
-    cv::Mat ret   = cv::Mat(rows, cols, CV_32SC1, -1);
-
-    for (ppp const &item : pixel_map) {
-        SpatialPoint dep_p = item.second;
-        int          dep_x = dep_p.pos.x;
-        int          dep_y = dep_p.pos.y;
-        if (0 <= dep_x && dep_x < dcols && //
-            0 <= dep_y && dep_y < drows) {
-            SpatialPoint ori_p        = item.first;
-            int          ori_x        = ori_p.pos.x;
-            int          ori_y        = ori_p.pos.y;
-            flt          depth        = disp.at<int>(dep_y, dep_x);
-            ret.at<int>(ori_y, ori_x) = depth;
+    if (pixel_map.index.size() != std::size_t(rows) * cols ||
+        disp.rows != pixel_map.rect_rows ||
+        disp.cols != pixel_map.rect_cols || !disp.isContinuous()) {
+        eprintf("Pixel map does not match the %dx%d disparity map\n",
+                disp.cols, disp.rows);
+    }
+    cv::Mat    ret   = cv::Mat(rows, cols, CV_32SC1);
+    int const *depth = disp.ptr<int>();
+    /* A plain gather, every original pixel is written exactly once */
+#pragma omp parallel for
+    for (int y = 0; y < rows; ++y) {
+        int32_t const *index = pixel_map.index.data() + std::size_t(y) * cols;
+        int           *out   = ret.ptr<int>(y);
+#pragma omp simd
+        for (int x = 0; x < cols; ++x) {
+            out[x] = index[x] >= 0 ? depth[index[x]] : -1;
         }
     }
-
     return ret;
 }
 
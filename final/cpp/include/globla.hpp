@@ -62,6 +62,14 @@ struct MiscConf {
     flt      dyavg, dymax;
 };
 using ppp = std::pair<SpatialPoint, SpatialPoint>;
+/* Pixel of the rectified image that every pixel of an original image lands
+ * on, as the linear index y * `rect_cols` + x, -1 if it lands outside.  An
+ * empty map stands for no rectification.
+ */
+struct PixelMap {
+    int                  rect_rows, rect_cols; // Size of the rectified image
+    std::vector<int32_t> index;                // Original pixels, row-major
+};
 
 /* Struct helper functions */
 inline void dump(CamConf const &x) {
@@ -101,7 +109,7 @@ template <typename T> bool inrange(T const &x, T const &lo, T const &hi) {
 std::tuple<CamConf, CamConf> read_cam(std::string const &filename);
 MiscConf                     read_calib(std::string const &filename);
 
-cv::Mat map_back(std::vector<ppp> const &pixel_map, int const &rows,
+cv::Mat map_back(PixelMap const &pixel_map, int const &rows,
                  int const &cols, cv::Mat const &disp);
 cv::Mat visualize(cv::Mat const &input, flt const &gamma = 0.3);
 
@@ -0,0 +1,164 @@
+#include "sgm.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <type_traits>
+
+#include <omp.h>
+
+/* Path directions (dy, dx) of the forward sweep, the backward sweep walks
+ * the opposite ones.  The first 4 directions make up the 8-path set, the
+ * remaining ones are added for the 16-path set.
+ */
+static int const directions[8][2] = {{0, 1},  {1, -1}, {1, 0},  {1, 1},
+                                     {1, -2}, {1, 2},  {2, -1}, {2, 1}};
+
+/* Converts the costs of one pixel to 16-bit integers on the [0, 255] scale */
+template <typename T>
+static void load_costs(T const *src, uint16_t *dst, int const &n) {
+    if constexpr (std::is_same<T, uint8_t>::value) {
+        std::copy(src, src + n, dst);
+    } else {
+        for (int d = 0; d < n; ++d) {
+            dst[d] = uint16_t(src[d] / CostVolume<T>::scale() + 0.5);
+        }
+    }
+}
+
+/* Accumulates the path costs of `ndirs` directions of both sweeps into
+ * `sum`, which has the same layout as `volume`.
+ *
+ * Path costs of a pixel are stored with a 0xffff border on both ends, as
+ * required by `sgm_path()`.  Horizontal paths are independent between
+ * rows, so every row is handled by one thread.  The other paths only
+ * depend on the last 2 rows of the sweep, whose path costs are kept in a
+ * ring of 3 rows, and every row is split between threads.
+ */
+template <typename K, typename T>
+static void aggregate(CostVolume<T> const &volume, uint16_t const &p1,
+                      uint16_t const &p2, int const &ndirs,
+                      std::vector<uint16_t> &sum) {
+    int         rows   = volume.rows;
+    int         cols   = volume.cols;
+    int         ndisp  = volume.ndisp;
+    int         stride = ndisp + 2;
+    std::size_t plane  = std::size_t(cols) * ndisp;
+
+    /* Path costs before the first pixel of a path */
+    std::vector<uint16_t> origin(stride, 0);
+    origin.front() = origin.back() = 0xffff;
+
+    /* [Horizontal paths] */
+#pragma omp parallel
+    {
+        std::vector<uint16_t> cost(ndisp);
+        std::vector<uint16_t> prev(stride), cur(origin);
+#pragma omp for schedule(static)
+        for (int y = 0; y < rows; ++y) {
+            for (int sign : {1, -1}) {
+                prev         = origin;
+                int prev_min = 0;
+                for (int i = 0; i < cols; ++i) {
+                    int x = sign > 0 ? i : cols - 1 - i;
+                    load_costs(volume.at(y, x), cost.data(), ndisp);
+                    prev_min = K::sgm_path(cost.data(), prev.data() + 1,
+                                           prev_min, p1, p2, cur.data() + 1,
+                                           sum.data() + y * plane +
+                                               std::size_t(x) * ndisp,
+                                           ndisp);
+                    std::swap(prev, cur);
+                }
+            }
+        }
+    }
+    /* [/Horizontal paths] */
+
+    /* [Other paths] */
+    int                   nk = ndirs - 1;
+    std::vector<uint16_t> paths(3 * nk * std::size_t(cols) * stride, 0xffff);
+    std::vector<uint16_t> mins(3 * nk * std::size_t(cols));
+    auto record = [&](int const &y, int const &k, int const &x) {
+        return paths.data() +
+               ((std::size_t(y % 3) * nk + k) * cols + x) * stride;
+    };
+    auto record_min = [&](int const &y, int const &k, int const &x) {
+        return mins.data() + (std::size_t(y % 3) * nk + k) * cols + x;
+    };
+    for (int sign : {1, -1}) {
+#pragma omp parallel
+        {
+            std::vector<uint16_t> cost(ndisp);
+            for (int i = 0; i < rows; ++i) {
+                int y = sign > 0 ? i : rows - 1 - i;
+                /* The implicit barrier keeps rows in order */
+#pragma omp for schedule(static)
+                for (int x = 0; x < cols; ++x) {
+                    load_costs(volume.at(y, x), cost.data(), ndisp);
+                    uint16_t *s = sum.data() + y * plane +
+                                  std::size_t(x) * ndisp;
+                    for (int k = 0; k < nk; ++k) {
+                        int py = y - sign * directions[k + 1][0];
+                        int px = x - sign * directions[k + 1][1];
+                        uint16_t const *prev     = origin.data();
+                        uint16_t        prev_min = 0;
+                        if (inrange(py, 0, rows) && inrange(px, 0, cols)) {
+                            prev     = record(py, k, px);
+                            prev_min = *record_min(py, k, px);
+                        }
+                        *record_min(y, k, x) = K::sgm_path(
+                            cost.data(), prev + 1, prev_min, p1, p2,
+                            record(y, k, x) + 1, s, ndisp);
+                    }
+                }
+            }
+        }
+    }
+    /* [/Other paths] */
+}
+
+template <typename T>
+cv::Mat SGM(CostVolume<T> const &volume, int const &p1, int const &p2,
+            int const &npaths) {
+    if (npaths != 8 && npaths != 16) {
+        eprintf("Expected 8 or 16 paths, got %d\n", npaths);
+    }
+    if (p1 < 0 || p1 > p2) {
+        eprintf("Expected 0 <= p1 <= p2, got p1 = %d, p2 = %d\n", p1, p2);
+    }
+    /* Path costs are bounded by the maximal cost plus `p2` */
+    if (npaths * (255 + p2) > 0xffff) {
+        eprintf("Aggregated costs overflow 16 bits with p2 = %d\n", p2);
+    }
+    int rows  = volume.rows;
+    int cols  = volume.cols;
+    int ndisp = volume.ndisp;
+
+    vprintf("Aggregating costs along %d paths (%s) ..\n", npaths,
+            simd::name(simd::detect()));
+    std::vector<uint16_t> sum(volume.data.size(), 0);
+    simd::dispatch([&](auto isa) {
+        aggregate<decltype(isa)>(volume, p1, p2, npaths / 2, sum);
+    });
+
+    cv::Mat disparity(rows, cols, CV_32SC1);
+#pragma omp parallel for
+    for (int y = 0; y < rows; ++y) {
+        int *disp = disparity.ptr<int>(y);
+        for (int x = 0; x < cols; ++x) {
+            uint16_t const *s =
+                sum.data() + (std::size_t(y) * cols + x) * ndisp;
+            disp[x] = std::min_element(s, s + ndisp) - s;
+        }
+    }
+    return disparity;
+}
+
+template cv::Mat SGM(CostVolume<uint8_t> const &, int const &, int const &,
+                     int const &);
+template cv::Mat SGM(CostVolume<uint16_t> const &, int const &, int const &,
+                     int const &);
+template cv::Mat SGM(CostVolume<float> const &, int const &, int const &,
+                     int const &);
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 16:20 [CST]
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "costvolume.hpp"
+#include "globla.hpp"
+
+/* Semi-global matching (SGM).
+ * Matching costs are aggregated along `npaths` straight paths ending at
+ * every pixel, a disparity change of 1 between consecutive pixels on a path
+ * is penalized by `p1`, and larger changes are penalized by `p2`.  Costs are
+ * aggregated in 16-bit integers on the [0, 255] scale of
+ * `CostVolume<uint8_t>`, other cost types are rescaled on the fly.
+ * @param `volume` Cost volume filled by `SAD()` or `NCC()`.
+ * @param `p1`, `p2` Penalties on the [0, 255] cost scale, `p1` <= `p2`.
+ * @param `npaths` Number of path directions, either `8` or `16`.
+ * @return Disparity map (CV_32SC1) with minimal aggregated cost.
+ */
+template <typename T>
+cv::Mat SGM(CostVolume<T> const &volume, int const &p1 = 10,
+            int const &p2 = 120, int const &npaths = 8);
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 16:20 [CST]
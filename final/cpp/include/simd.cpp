@@ -0,0 +1,271 @@
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef SIMD_HAVE_AVX2
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#ifdef SIMD_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace simd {
+
+isa detect() {
+    static isa const detected = [] {
+        char const *env = std::getenv("STEREO_SIMD");
+        if (env && !std::strcmp(env, "scalar")) {
+            return isa::scalar;
+        }
+#ifdef SIMD_HAVE_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            return isa::avx2;
+        }
+#endif
+#ifdef SIMD_HAVE_NEON
+        return isa::neon;
+#endif
+        return isa::scalar;
+    }();
+    return detected;
+}
+
+char const *name(isa const &x) {
+    switch (x) {
+    case isa::avx2:
+        return "AVX2";
+    case isa::neon:
+        return "NEON";
+    default:
+        return "scalar";
+    }
+}
+
+/* [Scalar] */
+void scalar::absdiff_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                         int const &n, int const &sign) {
+    for (int i = 0; i < n; ++i) {
+        acc[i] += sign * std::abs(l[i] - r[i]);
+    }
+}
+void scalar::product_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                         int const &n, int const &sign) {
+    for (int i = 0; i < n; ++i) {
+        acc[i] += sign * l[i] * r[i];
+    }
+}
+void scalar::argmin_update(int const *cost, int *best, int *disp,
+                           int const &n, int const &d) {
+    for (int i = 0; i < n; ++i) {
+        if (best[i] > cost[i]) {
+            best[i] = cost[i];
+            disp[i] = d;
+        }
+    }
+}
+uint16_t scalar::sgm_path(uint16_t const *cost, uint16_t const *prev,
+                          uint16_t const &prev_min, uint16_t const &p1,
+                          uint16_t const &p2, uint16_t *cur, uint16_t *sum,
+                          int const &n) {
+    int      jump = prev_min + p2;
+    uint16_t ret  = 0xffff;
+    for (int i = 0; i < n; ++i) {
+        int v = std::min(std::min<int>(prev[i], jump),
+                         std::min(prev[i - 1] + p1, prev[i + 1] + p1));
+        cur[i] = cost[i] + v - prev_min;
+        sum[i] += cur[i];
+        ret = std::min(ret, cur[i]);
+    }
+    return ret;
+}
+/* [/Scalar] */
+
+#ifdef SIMD_HAVE_AVX2
+/* [AVX2] */
+// Adds (or subtracts) 8 widened 32-bit lanes to acc[0, 8).
+AVX2_TARGET static inline void acc8(int *acc, __m256i const &v,
+                                    int const &sign) {
+    __m256i a = _mm256_loadu_si256((__m256i const *)acc);
+    a = sign > 0 ? _mm256_add_epi32(a, v) : _mm256_sub_epi32(a, v);
+    _mm256_storeu_si256((__m256i *)acc, a);
+}
+
+AVX2_TARGET void avx2::absdiff_acc(uint8_t const *l, uint8_t const *r,
+                                   int *acc, int const &n, int const &sign) {
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i lv = _mm256_loadu_si256((__m256i const *)(l + i));
+        __m256i rv = _mm256_loadu_si256((__m256i const *)(r + i));
+        // |l - r| of unsigned bytes, one of the saturated differences is 0
+        __m256i ad = _mm256_or_si256(_mm256_subs_epu8(lv, rv),
+                                     _mm256_subs_epu8(rv, lv));
+        __m128i lo = _mm256_castsi256_si128(ad);
+        __m128i hi = _mm256_extracti128_si256(ad, 1);
+        acc8(acc + i, _mm256_cvtepu8_epi32(lo), sign);
+        acc8(acc + i + 8, _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)), sign);
+        acc8(acc + i + 16, _mm256_cvtepu8_epi32(hi), sign);
+        acc8(acc + i + 24, _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)),
+             sign);
+    }
+    scalar::absdiff_acc(l + i, r + i, acc + i, n - i, sign);
+}
+
+AVX2_TARGET void avx2::product_acc(uint8_t const *l, uint8_t const *r,
+                                   int *acc, int const &n, int const &sign) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i lv = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128((__m128i const *)(l + i)));
+        __m256i rv = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128((__m128i const *)(r + i)));
+        // Products of bytes fit in unsigned 16-bit lanes
+        __m256i prod = _mm256_mullo_epi16(lv, rv);
+        acc8(acc + i, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(prod)),
+             sign);
+        acc8(acc + i + 8,
+             _mm256_cvtepu16_epi32(_mm256_extracti128_si256(prod, 1)), sign);
+    }
+    scalar::product_acc(l + i, r + i, acc + i, n - i, sign);
+}
+
+AVX2_TARGET void avx2::argmin_update(int const *cost, int *best, int *disp,
+                                     int const &n, int const &d) {
+    __m256i dv = _mm256_set1_epi32(d);
+    int     i  = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i c    = _mm256_loadu_si256((__m256i const *)(cost + i));
+        __m256i b    = _mm256_loadu_si256((__m256i const *)(best + i));
+        __m256i p    = _mm256_loadu_si256((__m256i const *)(disp + i));
+        __m256i mask = _mm256_cmpgt_epi32(b, c);
+        _mm256_storeu_si256((__m256i *)(best + i), _mm256_min_epi32(b, c));
+        _mm256_storeu_si256((__m256i *)(disp + i),
+                            _mm256_blendv_epi8(p, dv, mask));
+    }
+    scalar::argmin_update(cost + i, best + i, disp + i, n - i, d);
+}
+AVX2_TARGET uint16_t avx2::sgm_path(uint16_t const *cost,
+                                    uint16_t const *prev,
+                                    uint16_t const &prev_min,
+                                    uint16_t const &p1, uint16_t const &p2,
+                                    uint16_t *cur, uint16_t *sum,
+                                    int const &n) {
+    __m256i vp1  = _mm256_set1_epi16(p1);
+    __m256i vmin = _mm256_set1_epi16(prev_min);
+    __m256i jump = _mm256_adds_epu16(vmin, _mm256_set1_epi16(p2));
+    __m256i best = _mm256_set1_epi16(-1);
+    int     i    = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i pc = _mm256_loadu_si256((__m256i const *)(prev + i));
+        __m256i pl = _mm256_loadu_si256((__m256i const *)(prev + i - 1));
+        __m256i pr = _mm256_loadu_si256((__m256i const *)(prev + i + 1));
+        // Saturated additions keep the 0xffff borders out of the minimum
+        __m256i v = _mm256_min_epu16(_mm256_adds_epu16(pl, vp1),
+                                     _mm256_adds_epu16(pr, vp1));
+        v = _mm256_min_epu16(_mm256_min_epu16(pc, jump), v);
+        v = _mm256_add_epi16(
+            _mm256_sub_epi16(v, vmin),
+            _mm256_loadu_si256((__m256i const *)(cost + i)));
+        __m256i s = _mm256_loadu_si256((__m256i const *)(sum + i));
+        _mm256_storeu_si256((__m256i *)(cur + i), v);
+        _mm256_storeu_si256((__m256i *)(sum + i), _mm256_add_epi16(s, v));
+        best = _mm256_min_epu16(best, v);
+    }
+    __m128i m = _mm_min_epu16(_mm256_castsi256_si128(best),
+                              _mm256_extracti128_si256(best, 1));
+    uint16_t ret = _mm_extract_epi16(_mm_minpos_epu16(m), 0);
+    return std::min(ret, scalar::sgm_path(cost + i, prev + i, prev_min, p1,
+                                          p2, cur + i, sum + i, n - i));
+}
+/* [/AVX2] */
+#endif
+
+#ifdef SIMD_HAVE_NEON
+/* [NEON] */
+void neon::absdiff_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                       int const &n, int const &sign) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t ad = vmovl_u8(vabd_u8(vld1_u8(l + i), vld1_u8(r + i)));
+        int32x4_t  lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(ad)));
+        int32x4_t  hi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(ad)));
+        int32x4_t  a0 = vld1q_s32(acc + i);
+        int32x4_t  a1 = vld1q_s32(acc + i + 4);
+        if (sign > 0) {
+            vst1q_s32(acc + i, vaddq_s32(a0, lo));
+            vst1q_s32(acc + i + 4, vaddq_s32(a1, hi));
+        } else {
+            vst1q_s32(acc + i, vsubq_s32(a0, lo));
+            vst1q_s32(acc + i + 4, vsubq_s32(a1, hi));
+        }
+    }
+    scalar::absdiff_acc(l + i, r + i, acc + i, n - i, sign);
+}
+
+void neon::product_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                       int const &n, int const &sign) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t prod = vmull_u8(vld1_u8(l + i), vld1_u8(r + i));
+        int32x4_t  lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(prod)));
+        int32x4_t hi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(prod)));
+        int32x4_t a0 = vld1q_s32(acc + i);
+        int32x4_t a1 = vld1q_s32(acc + i + 4);
+        if (sign > 0) {
+            vst1q_s32(acc + i, vaddq_s32(a0, lo));
+            vst1q_s32(acc + i + 4, vaddq_s32(a1, hi));
+        } else {
+            vst1q_s32(acc + i, vsubq_s32(a0, lo));
+            vst1q_s32(acc + i + 4, vsubq_s32(a1, hi));
+        }
+    }
+    scalar::product_acc(l + i, r + i, acc + i, n - i, sign);
+}
+
+void neon::argmin_update(int const *cost, int *best, int *disp,
+                         int const &n, int const &d) {
+    int32x4_t dv = vdupq_n_s32(d);
+    int       i  = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t  c    = vld1q_s32(cost + i);
+        int32x4_t  b    = vld1q_s32(best + i);
+        uint32x4_t mask = vcgtq_s32(b, c);
+        vst1q_s32(best + i, vminq_s32(b, c));
+        vst1q_s32(disp + i, vbslq_s32(mask, dv, vld1q_s32(disp + i)));
+    }
+    scalar::argmin_update(cost + i, best + i, disp + i, n - i, d);
+}
+uint16_t neon::sgm_path(uint16_t const *cost, uint16_t const *prev,
+                        uint16_t const &prev_min, uint16_t const &p1,
+                        uint16_t const &p2, uint16_t *cur, uint16_t *sum,
+                        int const &n) {
+    uint16x8_t vp1  = vdupq_n_u16(p1);
+    uint16x8_t vmin = vdupq_n_u16(prev_min);
+    uint16x8_t jump = vqaddq_u16(vmin, vdupq_n_u16(p2));
+    uint16x8_t best = vdupq_n_u16(0xffff);
+    int        i    = 0;
+    for (; i + 8 <= n; i += 8) {
+        // Saturated additions keep the 0xffff borders out of the minimum
+        uint16x8_t v = vminq_u16(vqaddq_u16(vld1q_u16(prev + i - 1), vp1),
+                                 vqaddq_u16(vld1q_u16(prev + i + 1), vp1));
+        v = vminq_u16(vminq_u16(vld1q_u16(prev + i), jump), v);
+        v = vaddq_u16(vsubq_u16(v, vmin), vld1q_u16(cost + i));
+        vst1q_u16(cur + i, v);
+        vst1q_u16(sum + i, vaddq_u16(vld1q_u16(sum + i), v));
+        best = vminq_u16(best, v);
+    }
+    uint16_t lanes[8];
+    vst1q_u16(lanes, best);
+    uint16_t ret = *std::min_element(lanes, lanes + 8);
+    return std::min(ret, scalar::sgm_path(cost + i, prev + i, prev_min, p1,
+                                          p2, cur + i, sum + i, n - i));
+}
+/* [/NEON] */
+#endif
+
+} // namespace simd
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 14:05 [CST]
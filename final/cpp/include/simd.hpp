@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+
+/* Vectorized kernels used by the local matchers.
+ *
+ * Every instruction set is a kernel struct with the same static member
+ * functions, so that callers can be instantiated per instruction set at
+ * compile-time and pick an instantiation at run-time with `dispatch()`.
+ * All kernels produce bit-exact results with respect to `scalar`.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_HAVE_AVX2 1
+#endif
+#if defined(__ARM_NEON)
+#define SIMD_HAVE_NEON 1
+#endif
+
+namespace simd {
+
+enum class isa { scalar, avx2, neon };
+
+struct scalar {
+    static isa const id = isa::scalar;
+    // acc[i] += sign * |l[i] - r[i]|, for i in [0, n)
+    static void absdiff_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                            int const &n, int const &sign);
+    // acc[i] += sign * l[i] * r[i], for i in [0, n)
+    static void product_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                            int const &n, int const &sign);
+    // Where cost[i] < best[i], set best[i] = cost[i] and disp[i] = d
+    static void argmin_update(int const *cost, int *best, int *disp,
+                              int const &n, int const &d);
+    // One semi-global matching path step over n disparities, returns the
+    // minimum of cur[0, n):
+    //   cur[i] = cost[i] - prev_min + min(prev[i], prev[i - 1] + p1,
+    //                                     prev[i + 1] + p1, prev_min + p2)
+    //   sum[i] += cur[i]
+    // prev[-1] and prev[n] must be readable and hold 0xffff.
+    static uint16_t sgm_path(uint16_t const *cost, uint16_t const *prev,
+                             uint16_t const &prev_min, uint16_t const &p1,
+                             uint16_t const &p2, uint16_t *cur,
+                             uint16_t *sum, int const &n);
+};
+#ifdef SIMD_HAVE_AVX2
+struct avx2 {
+    static isa const id = isa::avx2;
+    // acc[i] += sign * |l[i] - r[i]|, for i in [0, n)
+    static void absdiff_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                            int const &n, int const &sign);
+    // acc[i] += sign * l[i] * r[i], for i in [0, n)
+    static void product_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                            int const &n, int const &sign);
+    // Where cost[i] < best[i], set best[i] = cost[i] and disp[i] = d
+    static void argmin_update(int const *cost, int *best, int *disp,
+                              int const &n, int const &d);
+    // One semi-global matching path step over n disparities, returns the
+    // minimum of cur[0, n):
+    //   cur[i] = cost[i] - prev_min + min(prev[i], prev[i - 1] + p1,
+    //                                     prev[i + 1] + p1, prev_min + p2)
+    //   sum[i] += cur[i]
+    // prev[-1] and prev[n] must be readable and hold 0xffff.
+    static uint16_t sgm_path(uint16_t const *cost, uint16_t const *prev,
+                             uint16_t const &prev_min, uint16_t const &p1,
+                             uint16_t const &p2, uint16_t *cur,
+                             uint16_t *sum, int const &n);
+};
+#endif
+#ifdef SIMD_HAVE_NEON
+struct neon {
+    static isa const id = isa::neon;
+    // acc[i] += sign * |l[i] - r[i]|, for i in [0, n)
+    static void absdiff_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                            int const &n, int const &sign);
+    // acc[i] += sign * l[i] * r[i], for i in [0, n)
+    static void product_acc(uint8_t const *l, uint8_t const *r, int *acc,
+                            int const &n, int const &sign);
+    // Where cost[i] < best[i], set best[i] = cost[i] and disp[i] = d
+    static void argmin_update(int const *cost, int *best, int *disp,
+                              int const &n, int const &d);
+    // One semi-global matching path step over n disparities, returns the
+    // minimum of cur[0, n):
+    //   cur[i] = cost[i] - prev_min + min(prev[i], prev[i - 1] + p1,
+    //                                     prev[i + 1] + p1, prev_min + p2)
+    //   sum[i] += cur[i]
+    // prev[-1] and prev[n] must be readable and hold 0xffff.
+    static uint16_t sgm_path(uint16_t const *cost, uint16_t const *prev,
+                             uint16_t const &prev_min, uint16_t const &p1,
+                             uint16_t const &p2, uint16_t *cur,
+                             uint16_t *sum, int const &n);
+};
+#endif
+
+/* Best instruction set supported by the running CPU, detected once.  Set
+ * environment variable `STEREO_SIMD` to `scalar` to force the fallback.
+ */
+isa         detect();
+char const *name(isa const &x);
+
+/* Calls `f` with the kernel struct of the detected instruction set. */
+template <typename F> auto dispatch(F &&f) {
+    switch (detect()) {
+#ifdef SIMD_HAVE_AVX2
+    case isa::avx2:
+        return f(avx2{});
+#endif
+#ifdef SIMD_HAVE_NEON
+    case isa::neon:
+        return f(neon{});
+#endif
+    default:
+        return f(scalar{});
+    }
+}
+
+} // namespace simd
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 14:05 [CST]
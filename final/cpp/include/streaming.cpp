@@ -0,0 +1,235 @@
+#include "estimating.hpp"
+#include "geometry.hpp"
+#include "streaming.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+/* [PnmReader] */
+/* Next header token of a PNM file, comments are skipped.  The whitespace
+ * ending the token is consumed, so that the last token of the header is
+ * directly followed by the pixels.
+ */
+static std::string next_token(std::istream &in) {
+    std::string ret;
+    for (int c; (c = in.get()) != EOF;) {
+        if (c == '#') {
+            while ((c = in.get()) != EOF && c != '\n') {
+            }
+        } else if (std::isspace(c)) {
+            if (!ret.empty()) {
+                break;
+            }
+        } else {
+            ret.push_back(c);
+        }
+    }
+    return ret;
+}
+
+PnmReader::PnmReader(std::string const &filename)
+    : from{filename, std::ios::binary} {
+    if (from.fail()) {
+        eprintf("Failed opening file %s\n", filename.c_str());
+    }
+    std::string magic = next_token(from);
+    if (magic != "P6") {
+        eprintf("Expected a binary PPM (P6) image in %s, got magic '%s'\n",
+                filename.c_str(), magic.c_str());
+    }
+    cols       = std::stoi(next_token(from));
+    rows       = std::stoi(next_token(from));
+    int maxval = std::stoi(next_token(from));
+    if (maxval != 255) {
+        eprintf("Expected 8-bit samples in %s, got maxval %d\n",
+                filename.c_str(), maxval);
+    }
+    data = from.tellg();
+}
+
+void PnmReader::read(int const &r0, int const &r1, cv::Mat &out) {
+    out.create(r1 - r0, cols, CV_8UC3);
+    from.seekg(data + std::streamoff(r0) * cols * 3);
+    for (int y = 0; y < r1 - r0; ++y) {
+        uint8_t *row = out.ptr<uint8_t>(y);
+        from.read((char *)row, std::streamsize(cols) * 3);
+        /* PPM stores RGB, OpenCV images are BGR */
+        for (int x = 0; x < cols; ++x) {
+            std::swap(row[3 * x], row[3 * x + 2]);
+        }
+    }
+    if (from.fail()) {
+        eprintf("Failed reading rows [%d, %d)\n", r0, r1);
+    }
+}
+
+cv::Mat PnmReader::preview(int const &factor) {
+    int     prows = (rows + factor - 1) / factor;
+    int     pcols = (cols + factor - 1) / factor;
+    cv::Mat ret(prows, pcols, CV_8UC3);
+    cv::Mat strip;
+    /* Channel sums and pixel counts of the blocks of a preview row */
+    std::vector<int> sum(pcols * 3), cnt(pcols);
+    for (int py = 0; py < prows; ++py) {
+        read(py * factor, std::min((py + 1) * factor, rows), strip);
+        std::fill(sum.begin(), sum.end(), 0);
+        std::fill(cnt.begin(), cnt.end(), 0);
+        for (int y = 0; y < strip.rows; ++y) {
+            uint8_t const *row = strip.ptr<uint8_t>(y);
+            for (int x = 0; x < cols; ++x) {
+                for (int c = 0; c < 3; ++c) {
+                    sum[x / factor * 3 + c] += row[3 * x + c];
+                }
+                ++cnt[x / factor];
+            }
+        }
+        uint8_t *out = ret.ptr<uint8_t>(py);
+        for (int px = 0; px < pcols; ++px) {
+            for (int c = 0; c < 3; ++c) {
+                out[3 * px + c] =
+                    (sum[3 * px + c] + cnt[px] / 2) / cnt[px];
+            }
+        }
+    }
+    return ret;
+}
+/* [/PnmReader] */
+
+/* [PnmWriter] */
+PnmWriter::PnmWriter(std::string const &filename, int const &rows,
+                     int const &cols, int const &maxval)
+    : to{filename, std::ios::binary}, cols(cols), maxval(maxval) {
+    if (to.fail()) {
+        eprintf("Failed opening file %s\n", filename.c_str());
+    }
+    to << "P5\n" << cols << " " << rows << "\n" << maxval << "\n";
+}
+
+void PnmWriter::write(cv::Mat const &img) {
+    if (img.type() != CV_32SC1 || img.cols != cols) {
+        eprintf("Expected CV_32SC1 rows of %d pixels, got type %d with %d\n",
+                cols, img.type(), img.cols);
+    }
+    int               bytes = maxval > 255 ? 2 : 1;
+    std::vector<char> buf(std::size_t(cols) * bytes);
+    for (int y = 0; y < img.rows; ++y) {
+        int const *row = img.ptr<int>(y);
+        for (int x = 0; x < cols; ++x) {
+            int v = std::min(std::max(row[x], 0), maxval);
+            if (bytes == 2) {
+                /* 16-bit samples are big-endian */
+                buf[2 * x]     = v >> 8;
+                buf[2 * x + 1] = v & 0xff;
+            } else {
+                buf[x] = v;
+            }
+        }
+        to.write(buf.data(), buf.size());
+    }
+    /* Completed rows are visible to readers of the file right away */
+    to.flush();
+}
+/* [/PnmWriter] */
+
+/* Rectifies rows [`r0`, `r1`) of the left or right image, reading only the
+ * source rows they sample.  Pixels outside of the source image are black.
+ */
+static cv::Mat rectify_rows(PnmReader &reader, Rectification const &rect,
+                            bool const &right, int const &r0,
+                            int const &r1) {
+    cv::Mat mapx, mapy;
+    rectification_maps(rect, right, r0, r1, mapx, mapy);
+
+    /* Source rows sampled inside of the image, bilinear interpolation
+     * reaches 1 pixel further.
+     */
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    for (int y = 0; y < mapy.rows; ++y) {
+        float const *mx = mapx.ptr<float>(y);
+        float const *my = mapy.ptr<float>(y);
+        for (int x = 0; x < mapy.cols; ++x) {
+            if (-1 < mx[x] && mx[x] < reader.cols && //
+                -1 < my[x] && my[x] < reader.rows) {
+                lo = std::min(lo, my[x]);
+                hi = std::max(hi, my[x]);
+            }
+        }
+    }
+    cv::Mat ret(r1 - r0, rect.cols, CV_8UC3);
+    /* The whole band maps outside of the source image */
+    if (lo > hi) {
+        ret = 0;
+        return ret;
+    }
+    int s0 = std::max(0, int(std::floor(lo)));
+    int s1 = std::min(reader.rows, int(std::floor(hi)) + 2);
+    cv::Mat src;
+    reader.read(s0, s1, src);
+    for (int y = 0; y < mapy.rows; ++y) {
+        float *my = mapy.ptr<float>(y);
+        for (int x = 0; x < mapy.cols; ++x) {
+            my[x] -= s0;
+        }
+    }
+    cv::remap(src, ret, mapx, mapy, cv::INTER_LINEAR, cv::BORDER_CONSTANT,
+              cv::Scalar(0, 0, 0));
+    return ret;
+}
+
+void stream_stereo(std::string const &left_file,
+                   std::string const &right_file, MiscConf const &conf,
+                   int const &wr, std::string const &output,
+                   int const &band) {
+    PnmReader lin(left_file);
+    PnmReader rin(right_file);
+    if (lin.rows != rin.rows || lin.cols != rin.cols) {
+        eprintf("The given 2 stereo images has different sizes\n");
+    }
+    int rows = lin.rows;
+    int cols = lin.cols;
+
+    /* [Pose] */
+    /* Feature matching only needs a preview of bounded size, intrinsics are
+     * scaled accordingly.
+     */
+    int const preview_size = 1600;
+    int       factor =
+        std::max(1, (std::max(rows, cols) + preview_size - 1) / preview_size);
+    CamConf lcam = conf.left;
+    CamConf rcam = conf.right;
+    for (CamConf *cam : {&lcam, &rcam}) {
+        cam->fx /= factor;
+        cam->fy /= factor;
+        cam->cx /= factor;
+        cam->cy /= factor;
+    }
+    mat3 R1, R2;
+    rectifying_rotations(lin.preview(factor), rin.preview(factor), lcam,
+                         rcam, R1, R2);
+    Rectification rect =
+        make_rectification(conf.left, conf.right, R1, R2, rows, cols);
+    vprintf("Rectified images are %dx%d, matching in bands of %d rows\n",
+            rect.cols, rect.rows, band);
+    /* [/Pose] */
+
+    /* [Bands] */
+    int       ndisp = conf.ndisp == 0 ? rect.cols : conf.ndisp;
+    PnmWriter out(output, rect.rows, rect.cols, ndisp > 256 ? 65535 : 255);
+    progress  p((rect.rows + band - 1) / band, "Streaming");
+    for (int r0 = 0; r0 < rect.rows; r0 += band) {
+        int r1 = std::min(r0 + band, rect.rows);
+        /* Windows of the band reach `wr` rows beyond it */
+        cv::Mat lband = rectify_rows(lin, rect, false, r0 - wr, r1 + wr);
+        cv::Mat rband = rectify_rows(rin, rect, true, r0 - wr, r1 + wr);
+        /* Bands only advance the "Streaming" bar */
+        cv::Mat disp  = SAD(lband, rband, wr, conf, default_tile, nullptr);
+        out.write(disp.rowRange(wr, wr + r1 - r0));
+        p.advance();
+    }
+    /* [/Bands] */
+}
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 18:40 [CST]
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "globla.hpp"
+
+#include <fstream>
+#include <string>
+
+/* Reader of binary PPM (P6, 8-bit) images that loads arbitrary row ranges
+ * without reading the rest of the file.
+ */
+struct PnmReader {
+    PnmReader(std::string const &filename);
+
+    int rows, cols;
+    /* Reads rows [`r0`, `r1`) into `out` as a CV_8UC3 (BGR) image */
+    void read(int const &r0, int const &r1, cv::Mat &out);
+    /* Whole image shrunk by `factor` with box filtering, reading `factor`
+     * rows at a time.
+     */
+    cv::Mat preview(int const &factor);
+
+  private:
+    std::ifstream  from;
+    std::streamoff data; // Offset of the first pixel in the file
+};
+
+/* Writer of binary PGM (P5) images, rows are appended as they complete.
+ * Samples are 16-bit when `maxval` > 255, 8-bit otherwise.
+ */
+struct PnmWriter {
+    PnmWriter(std::string const &filename, int const &rows, int const &cols,
+              int const &maxval);
+
+    /* Appends the rows of `img` (CV_32SC1), values are clamped to
+     * [0, `maxval`].
+     */
+    void write(cv::Mat const &img);
+
+  private:
+    std::ofstream to;
+    int           cols, maxval;
+};
+
+/* Streaming stereo matching of images that do not fit in memory.
+ * The relative pose is estimated on downsized previews, then the rectified
+ * images are processed in bands of rows: every band is rectified from the
+ * source rows it needs, matched with `SAD()`, and written out right away.
+ * The working set is bounded by the band size (plus the skew of the
+ * rectifying rotations), rather than by the image size.
+ * @param `{left,right}_file` Binary PPM (P6) stereo images.
+ * @param `conf` Configs, `ndisp` must be set.
+ * @param `wr` Window radius of `SAD()`.
+ * @param `output` Disparity map written as a PGM image, in **rectified**
+ *        coordinates.
+ * @param `band` Number of rectified rows matched at a time.
+ */
+void stream_stereo(std::string const &left_file,
+                   std::string const &right_file, MiscConf const &conf,
+                   int const &wr, std::string const &output,
+                   int const &band = 256);
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 18:40 [CST]
@@ -1,17 +1,22 @@
 #include "estimating.hpp"
 #include "geometry.hpp"
 #include "globla.hpp"
+#include "sgm.hpp"
+#include "streaming.hpp"
 
 #include <cassert>
 #include <cstdio>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <opencv2/opencv.hpp>
 
 void Usage(char **argv) {
-    fprintf(stderr, "Usage: %s <left-image> <right-image> <calib.txt>\n",
+    fprintf(stderr,
+            "Usage: %s <left-image> <right-image> <calib.txt> "
+            "[sad|pyramid|ncc|global|sgm|stream|all] [strips]\n",
             argv[0]);
 }
 
@@ -24,7 +29,6 @@ int main(int argc, char **argv) {
 
     /* [Variables] */
     cv::Mat limg, rimg;
-    int     factor = 1;
     /* [/Variables] */
 
     /* [Parse args] */
@@ -32,6 +36,24 @@ int main(int argc, char **argv) {
         Usage(argv);
         return 1;
     }
+    /* Disparity estimation method(s) to run, defaults to all of them */
+    std::string mode = argc > 4 ? argv[4] : "all";
+    if (mode != "sad" && mode != "pyramid" && mode != "ncc" &&
+        mode != "global" && mode != "sgm" && mode != "stream" &&
+        mode != "all") {
+        Usage(argv);
+        return 1;
+    }
+    /* Graph-cut strips optimized in parallel, see `global_optimization()` */
+    int      strips = argc > 5 ? std::stoi(argv[5]) : 1;
+    MiscConf conf   = read_calib(argv[3]);
+    int      wr     = 5;
+    if (mode == "stream") {
+        /* Images are never loaded as a whole, see `stream_stereo()` */
+        stream_stereo(argv[1], argv[2], conf, wr, "disp_stream.pgm");
+        vprintf("Disparity map written\n");
+        return 0;
+    }
     limg     = cv::imread(argv[1], cv::IMREAD_COLOR);
     rimg     = cv::imread(argv[2], cv::IMREAD_COLOR);
     int rows = limg.rows;
@@ -39,15 +61,14 @@ int main(int argc, char **argv) {
     if (rows != rimg.rows || cols != rimg.cols) {
         eprintf("The given 2 stereo images has different sizes\n");
     }
-    MiscConf conf  = read_calib(argv[3]);
-    CamConf  lconf = conf.left;
-    CamConf  rconf = conf.right;
+    CamConf lconf = conf.left;
+    CamConf rconf = conf.right;
     /* [/Parse args] */
 
     cv::Mat l_rect, r_rect;
     /* [Stereo rectification] */
-    flt              baseline = std::numeric_limits<flt>::lowest();
-    std::vector<ppp> pixel_map =
+    flt      baseline = std::numeric_limits<flt>::lowest();
+    PixelMap pixel_map =
         stereo_rectification(limg, rimg, lconf, rconf, l_rect, r_rect);
     cv::imwrite("l_rect.jpg", l_rect);
     cv::imwrite("r_rect.jpg", r_rect);
@@ -56,36 +77,62 @@ int main(int argc, char **argv) {
     // /* [No rectification] */
     // l_rect = limg;
     // r_rect = rimg;
-    // std::vector<ppp> pixel_map;
+    // PixelMap pixel_map{};
     // /* [/No rectification] */
 
-    int wr = 5;
-
     /* [SAD] */
-    cv::Mat disp_SAD = SAD(l_rect, r_rect, wr, conf);
-    disp_SAD         = map_back(pixel_map, rows, cols, disp_SAD);
-    cv::imwrite("disp_SAD.pgm", disp_SAD);
-    cv::Mat disp_SAD_vis = visualize(disp_SAD);
-    cv::imwrite("disp_SAD.jpg", disp_SAD_vis);
+    if (mode == "sad" || mode == "all") {
+        cv::Mat disp_SAD = SAD(l_rect, r_rect, wr, conf);
+        disp_SAD         = map_back(pixel_map, rows, cols, disp_SAD);
+        cv::imwrite("disp_SAD.pgm", disp_SAD);
+        cv::Mat disp_SAD_vis = visualize(disp_SAD);
+        cv::imwrite("disp_SAD.jpg", disp_SAD_vis);
+    }
     /* [/SAD] */
 
+    /* [SAD pyramid] */
+    if (mode == "pyramid" || mode == "all") {
+        cv::Mat disp_pyramid = SAD_pyramid(l_rect, r_rect, wr, conf);
+        disp_pyramid         = map_back(pixel_map, rows, cols, disp_pyramid);
+        cv::imwrite("disp_SAD_pyramid.pgm", disp_pyramid);
+        cv::Mat disp_pyramid_vis = visualize(disp_pyramid);
+        cv::imwrite("disp_SAD_pyramid.jpg", disp_pyramid_vis);
+    }
+    /* [/SAD pyramid] */
+
     /* [NCC] */
-    cv::Mat disp_NCC = NCC(l_rect, r_rect, wr, conf);
-    disp_NCC         = map_back(pixel_map, rows, cols, disp_NCC);
-    cv::imwrite("disp_NCC.pgm", disp_NCC);
-    cv::Mat disp_NCC_vis = visualize(disp_NCC);
-    cv::imwrite("disp_NCC.jpg", disp_NCC_vis);
+    /* Matching costs of NCC are kept for the global methods */
+    CostVolume<uint8_t> volume;
+    if (mode != "sad" && mode != "pyramid") {
+        cv::Mat disp_NCC = NCC(l_rect, r_rect, wr, conf, volume);
+        disp_NCC         = map_back(pixel_map, rows, cols, disp_NCC);
+        cv::imwrite("disp_NCC.pgm", disp_NCC);
+        cv::Mat disp_NCC_vis = visualize(disp_NCC);
+        cv::imwrite("disp_NCC.jpg", disp_NCC_vis);
+    }
     /* [/NCC] */
 
     /* [Global] */
-    cv::Mat data        = downsample<int>(disp_NCC, factor);
-    cv::Mat disp_global = global_optimization(data, conf);
-    disp_global         = upsample<int>(disp_global, factor);
-    cv::imwrite("disp_global.pgm", disp_global);
-    cv::Mat disp_global_vis = visualize(disp_global);
-    cv::imwrite("disp_global.jpg", disp_global_vis);
+    if (mode == "global" || mode == "all") {
+        cv::Mat disp_global =
+            global_optimization(volume, conf, 6, 1, 0, strips);
+        disp_global         = map_back(pixel_map, rows, cols, disp_global);
+        cv::imwrite("disp_global.pgm", disp_global);
+        cv::Mat disp_global_vis = visualize(disp_global);
+        cv::imwrite("disp_global.jpg", disp_global_vis);
+    }
     /* [/Global] */
 
+    /* [SGM] */
+    if (mode == "sgm" || mode == "all") {
+        cv::Mat disp_SGM = SGM(volume);
+        disp_SGM         = map_back(pixel_map, rows, cols, disp_SGM);
+        cv::imwrite("disp_SGM.pgm", disp_SGM);
+        cv::Mat disp_SGM_vis = visualize(disp_SGM);
+        cv::imwrite("disp_SGM.jpg", disp_SGM_vis);
+    }
+    /* [/SGM] */
+
     return 0;
 }
 
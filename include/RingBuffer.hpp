@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Bounded FIFO queue connecting the threads of a pipeline.
+template <typename T> class RingBuffer {
+  private:
+    std::vector<T> slots;
+    // Index of the oldest item
+    size_t head;
+    // Number of items held
+    size_t count;
+    // Number of items overwritten by `push_latest()`
+    size_t ndropped;
+    // No more items will be pushed
+    bool closed;
+
+    std::mutex              mtx;
+    std::condition_variable nonempty;
+    std::condition_variable nonfull;
+
+  public:
+    RingBuffer(size_t const &capacity)
+        : slots(capacity), head{0}, count{0}, ndropped{0}, closed{false} {}
+
+    // Push `item`, blocks while the buffer is full.  Returns false if the
+    // buffer is closed.
+    bool push(T &&item) {
+        std::unique_lock<std::mutex> lock(this->mtx);
+        this->nonfull.wait(lock, [this] {
+            return this->closed || this->count < this->slots.size();
+        });
+        if (this->closed) {
+            return false;
+        }
+        this->slots[(this->head + this->count++) % this->slots.size()] =
+            std::move(item);
+        this->nonempty.notify_one();
+        return true;
+    }
+
+    // Push `item` without blocking, the oldest item is dropped if the buffer
+    // is full.  Returns false if the buffer is closed.
+    bool push_latest(T &&item) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        if (this->closed) {
+            return false;
+        }
+        if (this->count == this->slots.size()) {
+            this->head = (this->head + 1) % this->slots.size();
+            --this->count;
+            ++this->ndropped;
+        }
+        this->slots[(this->head + this->count++) % this->slots.size()] =
+            std::move(item);
+        this->nonempty.notify_one();
+        return true;
+    }
+
+    // Pop the oldest item into `item`, blocks while the buffer is empty.
+    // Returns false once the buffer is closed and drained.
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(this->mtx);
+        this->nonempty.wait(
+            lock, [this] { return this->closed || this->count > 0; });
+        if (this->count == 0) {
+            return false;
+        }
+        item = std::move(this->slots[this->head]);
+        this->head = (this->head + 1) % this->slots.size();
+        --this->count;
+        this->nonfull.notify_one();
+        return true;
+    }
+
+    // Stop accepting items and wake up all waiting threads.
+    void close() {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        this->closed = true;
+        this->nonempty.notify_all();
+        this->nonfull.notify_all();
+    }
+
+    // Number of items dropped by `push_latest()`.
+    size_t dropped() {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        return this->ndropped;
+    }
+};
+
+// Author: Blurgy <gy@blurgy.xyz>
+// Date:   Oct 17 2026, 20:05 [CST]
@@ -2,100 +2,255 @@
 
 #include <omp.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <vector>
 
 namespace pa2 {
 
 // Constants
 cv::Scalar const marker_color{20, 89, 200};
+// Size of the tiles the detector is split into
+int const tile_rows = 64;
+int const tile_cols = 256;
+
+// Calls `f(tile)` for every tile of `region` handed out to this thread, must
+// be called from within a parallel region.
+template <typename Func>
+static void for_tiles(cv::Rect const &region, Func f) {
+    int trows = (region.height + tile_rows - 1) / tile_rows;
+    int tcols = (region.width + tile_cols - 1) / tile_cols;
+#pragma omp for schedule(dynamic) collapse(2)
+    for (int ti = 0; ti < trows; ++ti) {
+        for (int tj = 0; tj < tcols; ++tj) {
+            cv::Rect tile(region.x + tj * tile_cols,
+                          region.y + ti * tile_rows, tile_cols, tile_rows);
+            f(tile & region);
+        }
+    }
+}
+
+// Shared state of `radix_select()`
+struct RadixSelect {
+    int      hist[1 << 11];
+    uint32_t prefix, mask;
+    int      rank;
+};
+
+// Selects the threshold of `nms_threshold()` with the threads of the
+// enclosing parallel region, all of which have to call it.
+static float radix_select(cv::Mat const &frame, RadixSelect &st);
 
 cv::Mat harris(cv::Mat const &frame, size_t const &wr) {
-    cv::Mat img = frame.clone();
-    cv::Mat ret = frame.clone();
-    if (img.channels() == 3) {
-        cv::cvtColor(img, img, cv::COLOR_BGR2GRAY);
-    }
-    if (img.channels() == 1) {
-        img.convertTo(img, CV_64FC1);
-    }
-    assert(img.type() == CV_64FC1);
-
-    size_t ws   = wr * 2 + 1;
-    size_t rows = img.rows, row_ub = rows - ws;
-    size_t cols = img.cols, col_ub = cols - ws;
-
-    // Windows
-    cv::Rect win_global  = cv::Rect{0, 0, static_cast<int>(cols - 1),
-                                   static_cast<int>(rows - 1)};
-    cv::Rect xwin_global = cv::Rect{1, 0, static_cast<int>(cols - 1),
-                                    static_cast<int>(rows - 1)};
-    cv::Rect ywin_global = cv::Rect{0, 1, static_cast<int>(cols - 1),
-                                    static_cast<int>(rows - 1)};
-    // Gradient images
-    cv::Mat Ixmat = img(xwin_global) - img(win_global);
-    cv::Mat Iymat = img(ywin_global) - img(win_global);
-    // Precomputes
-    cv::Mat Ixxmat = Ixmat.mul(Ixmat);
-    cv::Mat Ixymat = Ixmat.mul(Iymat);
-    cv::Mat Iyymat = Iymat.mul(Iymat);
-
-    cv::Mat pIxxmat, pIxymat, pIyymat;
-    cv::integral(Ixxmat, pIxxmat);
-    cv::integral(Ixymat, pIxymat);
-    cv::integral(Iyymat, pIyymat);
-
-    // Minimum eigen value of each window
-    cv::Mat eigenmin =
-        cv::Mat(static_cast<int>(rows), static_cast<int>(cols),
-                CV_64FC1); // Maximum eigen value of each window
-    cv::Mat eigenmax =
-        cv::Mat(static_cast<int>(rows), static_cast<int>(cols), CV_64FC1);
-
-    printf("Computing max/min eigenvalues in each window..\n");
-    // Iterate each window in image, `i` for y-direction (rows), `j` for
-    // x-direction (cols).
-    for (size_t i = 0; i < row_ub; ++i) {
-#pragma omp parallel for
-        for (size_t j = 0; j < col_ub; ++j) {
-            // Generate covariance matrix
-            double Ixx{getsum(pIxxmat, i, j, i + ws, j + ws)};
-            double Ixy{getsum(pIxymat, i, j, i + ws, j + ws)};
-            double Iyy{getsum(pIyymat, i, j, i + ws, j + ws)};
-            // Compute eigenvalues of covariace matrix
-            auto [mine, maxe] = eigen(Ixx, Ixy, Iyy);
-            // Assign eigenvalues to corresponding matrices
-            eigenmin.at<double>(i, j) = mine;
-            eigenmax.at<double>(i, j) = maxe;
+    cv::Mat        ret = frame.clone();
+    HarrisDetector detector(frame.size(), wr);
+    detector.set_dump("img");
+
+    printf("Computing max/min eigenvalues and corners ..\n");
+    detector.detect(frame);
+
+    printf("Drawing markers at detected corners ..\n");
+    detector.draw(ret);
+
+    return ret;
+}
+
+HarrisDetector::HarrisDetector(cv::Size const &size, size_t const &wr)
+    : wr{wr}, scratch(omp_get_max_threads()), local(scratch.size()) {
+    this->resize(size);
+}
+
+void HarrisDetector::resize(cv::Size const &size) {
+    this->size = size;
+    // Pixels without a full window are never written.
+    this->eigenmin = cv::Mat::zeros(size, CV_32FC1);
+    this->eigenmax = cv::Mat::zeros(size, CV_32FC1);
+}
+
+void HarrisDetector::set_nms_radius(int const &radius) {
+    this->nmsr = radius;
+}
+
+void HarrisDetector::set_dump(std::string const &dir) {
+    this->dumpdir = dir;
+    // Create directory `dir` if it does not exist.
+    if (!dir.empty() && !std::filesystem::exists(dir)) {
+        std::filesystem::create_directories(dir);
+    }
+}
+
+std::vector<cv::KeyPoint> const &
+HarrisDetector::detect(cv::Mat const &frame) {
+    if (frame.size() != this->size) {
+        this->resize(frame.size());
+    }
+    // Reuses `gray` as long as the stream keeps its format.
+    cv::Mat const *src = &frame;
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame, this->gray, cv::COLOR_BGR2GRAY);
+        src = &this->gray;
+    }
+    if (src->depth() != CV_8U && src->depth() != CV_32F) {
+        src->convertTo(this->gray, CV_32F);
+        src = &this->gray;
+    }
+
+    int ws = this->wr * 2 + 1;
+    // Pixels that have a full window
+    cv::Rect valid(0, 0, std::max(this->size.width - ws, 0),
+                   std::max(this->size.height - ws, 0));
+
+    this->corners.clear();
+    for (std::vector<cv::Point2i> &found : this->local) {
+        found.clear();
+    }
+    RadixSelect select;
+#pragma omp parallel num_threads(this->scratch.size())
+    {
+        std::vector<double> &buf = this->scratch[omp_get_thread_num()];
+        for_tiles(valid, [&](cv::Rect const &tile) {
+            structure_tensor(*src, this->wr, this->eigenmin, this->eigenmax,
+                             tile, buf);
+        });
+
+#pragma omp single
+        if (!this->dumpdir.empty()) {
+            // Save max/min eigenvalue images to file, before non-maximum
+            // suppression.
+            cv::imwrite(this->dumpdir + "/eigenmax.png", this->eigenmax);
+            cv::imwrite(this->dumpdir + "/eigenmin.png", this->eigenmin);
         }
+        // No need of NMS for eigenmax
+        float threshold = radix_select(this->eigenmin, select);
+
+        // Non-maximum suppression, every thread collects the corners of its
+        // own tiles.
+        std::vector<cv::Point2i> &found = this->local[omp_get_thread_num()];
+        for_tiles(valid, [&](cv::Rect const &tile) {
+            nms(this->eigenmin, threshold, tile, found, this->nmsr);
+        });
     }
 
-    printf("Saving max/min eigenvalues ..\n");
-    // Create directory `img` if it does not exist.
-    if (!std::filesystem::exists("img")) {
-        std::filesystem::create_directory("img");
+    for (std::vector<cv::Point2i> const &found : this->local) {
+        for (cv::Point2i const &p : found) {
+            this->corners.emplace_back(p, ws, -1,
+                                       this->eigenmin.at<float>(p));
+        }
     }
-    // Save max/min eigenvalue images to file, before non-maximum suppression.
-    cv::imwrite("img/eigenmax.png", eigenmax);
-    cv::imwrite("img/eigenmin.png", eigenmin);
 
-    // Non-maximum suppression
-    eigenmin = nms(eigenmin);
-    // // No need of NMS for eigenmax
-    // eigenmax = nms(eigenmax);
+    return this->corners;
+}
 
-    printf("Drawing markers at detected corners ..\n");
-    // Draw markers at detected corners
-    for (size_t i = 0; i < rows; ++i) {
-#pragma omp parallel for
-        for (size_t j = 0; j < cols; ++j) {
-            if (eigenmin.at<unsigned char>(i, j) == 255) {
-                cv::circle(ret, cv::Point2i(j, i), wr * 10, marker_color);
-            }
+void HarrisDetector::draw(cv::Mat &frame) const {
+    for (cv::KeyPoint const &kp : this->corners) {
+        cv::circle(frame, kp.pt, this->wr * 10, marker_color);
+    }
+}
+
+// Converts `n` pixels of row `r` of `gray` from column `c` on to double.
+static void load_row(cv::Mat const &gray, int const &r, int const &c,
+                     int const &n, double *dst) {
+    if (gray.depth() == CV_8U) {
+        unsigned char const *src = gray.ptr<unsigned char>(r) + c;
+#pragma omp simd
+        for (int x = 0; x < n; ++x) {
+            dst[x] = src[x];
+        }
+    } else {
+        float const *src = gray.ptr<float>(r) + c;
+#pragma omp simd
+        for (int x = 0; x < n; ++x) {
+            dst[x] = src[x];
         }
     }
+}
 
-    return ret;
+void structure_tensor(cv::Mat const &gray, size_t const &wr,
+                      cv::Mat &eigenmin, cv::Mat &eigenmax,
+                      cv::Rect const &roi) {
+    std::vector<double> buf;
+    structure_tensor(gray, wr, eigenmin, eigenmax, roi, buf);
+}
+
+void structure_tensor(cv::Mat const &gray, size_t const &wr,
+                      cv::Mat &eigenmin, cv::Mat &eigenmax,
+                      cv::Rect const &roi, std::vector<double> &buf) {
+    assert(gray.type() == CV_8UC1 || gray.type() == CV_32FC1);
+    assert(eigenmin.type() == CV_32FC1 && eigenmax.type() == CV_32FC1);
+
+    int ws = wr * 2 + 1;
+    if (roi.empty()) {
+        return;
+    }
+    assert(roi.x >= 0 && roi.x + roi.width + ws <= gray.cols);
+    assert(roi.y >= 0 && roi.y + roi.height + ws <= gray.rows);
+    int iw = roi.width + ws; // Width of the image rows
+    int gw = iw - 1;         // Width of the gradient rows
+    int ow = roi.width;      // Width of the eigenvalue rows
+
+    // Two image rows, the gradient products of the last `ws` rows (slot `r
+    // % ws` for gradient row `r`), their sums over each column and the sums
+    // over each window.  With 8-bit images every value is an integer below
+    // (2 * `wr` + 1)^2 * 255^2, far below 2^53, so that adding and
+    // subtracting rows is exact in double whatever the window size.
+    buf.assign(2 * iw + 3 * (ws + 1) * gw + 3 * ow, 0.);
+    double *above = buf.data(), *below = above + iw;
+    double *ring = below + iw;
+    double *sxx = ring + 3 * ws * gw, *sxy = sxx + gw, *syy = sxy + gw;
+    double *hxx = syy + gw, *hxy = hxx + ow, *hyy = hxy + ow;
+
+    int rlb = roi.y, rub = roi.y + roi.height;
+    load_row(gray, rlb, roi.x, iw, above);
+    // Window of row `i` covers gradient rows [i, i + ws).
+    for (int r = rlb; r < rub + ws - 1; ++r) {
+        load_row(gray, r + 1, roi.x, iw, below);
+        double *pxx = ring + 3 * gw * ((r - rlb) % ws);
+        double *pxy = pxx + gw, *pyy = pxy + gw;
+        // The slot holds the products of row `r - ws` (zero at first),
+        // which leave the window as row `r` enters it.
+#pragma omp simd
+        for (int x = 0; x < gw; ++x) {
+            double ix = above[x + 1] - above[x];
+            double iy = below[x] - above[x];
+            double xx = ix * ix, xy = ix * iy, yy = iy * iy;
+            sxx[x] += xx - pxx[x];
+            sxy[x] += xy - pxy[x];
+            syy[x] += yy - pyy[x];
+            pxx[x] = xx;
+            pxy[x] = xy;
+            pyy[x] = yy;
+        }
+        std::swap(above, below);
+        if (r + 1 < rlb + ws) {
+            continue;
+        }
+
+        int    i    = r + 1 - ws;
+        float *emin = eigenmin.ptr<float>(i) + roi.x;
+        float *emax = eigenmax.ptr<float>(i) + roi.x;
+        // Horizontal sums, one shifted row at a time so that every loop runs
+        // across the row.
+        std::fill(hxx, hxx + 3 * ow, 0.);
+        for (int k = 0; k < ws; ++k) {
+#pragma omp simd
+            for (int j = 0; j < ow; ++j) {
+                hxx[j] += sxx[j + k];
+                hxy[j] += sxy[j + k];
+                hyy[j] += syy[j + k];
+            }
+        }
+#pragma omp simd
+        for (int j = 0; j < ow; ++j) {
+            // Same as `eigen()`
+            double A = hxx[j] + hyy[j];
+            double B = std::sqrt(sq(hxx[j] - hyy[j]) + sq(hxy[j] + hxy[j]));
+            emin[j]  = .5 * (A - B);
+            emax[j]  = .5 * (A + B);
+        }
+    }
 }
 
 std::tuple<double, double> eigen(double const &a, double const &b,
@@ -119,42 +274,130 @@ double getsum(cv::Mat const &from, size_t const &rlb, size_t const &clb,
     }
 }
 
-cv::Mat nms(cv::Mat const &frame) {
-    assert(frame.type() == CV_64FC1);
+// Maps floats to unsigned keys of the same order.
+static uint32_t float_key(float const &v) {
+    uint32_t u;
+    std::memcpy(&u, &v, sizeof(u));
+    return u ^ (u >> 31 ? 0xffffffffu : 0x80000000u);
+}
 
-    int rows = frame.rows;
-    int cols = frame.cols;
-    int size = rows * cols;
+// Inverse of `float_key()`.
+static float key_float(uint32_t const &k) {
+    uint32_t u = k ^ (k >> 31 ? 0x80000000u : 0xffffffffu);
+    float    v;
+    std::memcpy(&v, &u, sizeof(v));
+    return v;
+}
 
-    cv::Mat ret(frame.rows, frame.cols, CV_8UC1);
+float nms_threshold(cv::Mat const &frame) {
+    assert(frame.type() == CV_32FC1);
 
-    double median    = 0;
-    double threshold = -1;
+    RadixSelect st;
+    float       threshold = 0;
+#pragma omp parallel
+    {
+        float t = radix_select(frame, st);
+#pragma omp single nowait
+        threshold = t;
+    }
+    return threshold;
+}
+
+static float radix_select(cv::Mat const &frame, RadixSelect &st) {
+    int size = frame.rows * frame.cols;
+    if (size == 0) {
+        return 0;
+    }
+    // The threshold is the `rank`-th largest response.
+#pragma omp single
+    {
+        int reserved = std::max(30, (int)(.0001 * size));
+        st.rank      = std::min(reserved, size);
+        st.prefix = st.mask = 0;
+    }
 
-    std::vector<double> array;
-    for (int i = 0; i < frame.rows; ++i) {
-        auto x = frame.ptr<double>(i);
-        for (int j = 0; j < frame.cols; ++j) {
-            array.push_back(x[j]);
+    // Radix select over the keys of the responses, from the most
+    // significant digit on.  Every pass counts the keys that share the
+    // digits found so far, so `frame` is read three times but never copied.
+    int const digits[][2] = {{21, 11}, {10, 11}, {0, 10}}; // {shift, bits}
+    for (auto const &[shift, bits] : digits) {
+        int      local[1 << 11] = {};
+        uint32_t bmask          = (1u << bits) - 1;
+        uint32_t prefix = st.prefix, mask = st.mask;
+#pragma omp single
+        std::fill(st.hist, st.hist + bmask + 1, 0);
+#pragma omp for nowait
+        for (int i = 0; i < frame.rows; ++i) {
+            float const *x = frame.ptr<float>(i);
+            for (int j = 0; j < frame.cols; ++j) {
+                uint32_t key = float_key(x[j]);
+                if ((key & mask) == prefix) {
+                    ++local[(key >> shift) & bmask];
+                }
+            }
+        }
+#pragma omp critical(radix_select)
+        for (uint32_t b = 0; b <= bmask; ++b) {
+            st.hist[b] += local[b];
+        }
+#pragma omp barrier
+#pragma omp single
+        {
+            // Bucket holding the `rank`-th largest key
+            int b = bmask;
+            while (b > 0 && st.rank > st.hist[b]) {
+                st.rank -= st.hist[b--];
+            }
+            st.prefix |= uint32_t(b) << shift;
+            st.mask |= bmask << shift;
         }
     }
-    int reserved = std::max(30, (int)(.0001 * size));
-    int offset   = size - reserved;
-    std::nth_element(array.begin(), array.begin() + offset, array.end());
-    median    = array[offset];
-    threshold = median;
-
-    // Thresholding.
-    for (int i = 0; i < ret.rows; ++i) {
-#pragma omp parallel for
-        for (int j = 0; j < ret.cols; ++j) {
-            if (frame.at<double>(i, j) > threshold) {
-                ret.at<unsigned char>(i, j) = 255;
-            } else {
-                ret.at<unsigned char>(i, j) = 0;
+
+    return key_float(st.prefix);
+}
+
+void nms(cv::Mat const &frame, float const &threshold, cv::Rect const &roi,
+         std::vector<cv::Point2i> &corners, int const &radius) {
+    assert(frame.type() == CV_32FC1);
+    for (int i = roi.y; i < roi.y + roi.height; ++i) {
+        float const *x = frame.ptr<float>(i);
+        for (int j = roi.x; j < roi.x + roi.width; ++j) {
+            // Thresholding, only few pixels get past this.
+            if (x[j] <= threshold) {
+                continue;
+            }
+            // Keep local maxima.  Among equal neighbors, the first one in
+            // raster order wins.
+            bool maximum = true;
+            for (int y = std::max(i - radius, 0);
+                 maximum && y <= std::min(i + radius, frame.rows - 1); ++y) {
+                float const *n = frame.ptr<float>(y);
+                for (int z = std::max(j - radius, 0);
+                     z <= std::min(j + radius, frame.cols - 1); ++z) {
+                    bool before = y < i || (y == i && z < j);
+                    if (n[z] > x[j] || (before && n[z] == x[j])) {
+                        maximum = false;
+                        break;
+                    }
+                }
+            }
+            if (maximum) {
+                corners.emplace_back(j, i);
             }
         }
     }
+}
+
+cv::Mat nms(cv::Mat const &frame, int const &radius) {
+    float   threshold = nms_threshold(frame);
+    cv::Mat ret       = cv::Mat::zeros(frame.rows, frame.cols, CV_8UC1);
+
+    std::vector<cv::Point2i> corners;
+    nms(frame, threshold, cv::Rect(0, 0, frame.cols, frame.rows), corners,
+        radius);
+    for (cv::Point2i const &p : corners) {
+        ret.at<unsigned char>(p) = 255;
+    }
 
     return ret;
 }
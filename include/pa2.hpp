@@ -1,6 +1,8 @@
 #include <opencv2/opencv.hpp>
 
+#include <string>
 #include <tuple>
+#include <vector>
 
 namespace pa2 {
 
@@ -10,6 +12,22 @@ extern cv::Scalar const marker_color;
 // @brief Harris corner detector
 cv::Mat harris(cv::Mat const &frame, size_t const &wr = 1);
 
+// @brief Minimum and maximum eigenvalues of the structure tensor of every
+// (2 * `wr` + 1)^2 window, computed in one streaming pass over the rows.
+// Sums are kept in double, the eigenvalues are stored as float32.  Windows
+// are anchored at their top-left pixel.
+// @param gray: Single channel image, CV_8UC1 or CV_32FC1.
+// @param eigenmin, eigenmax: CV_32FC1 images of the size of `gray`.
+// @param roi: Pixels of `eigenmin` and `eigenmax` to compute, their windows
+// must lie within `gray`.
+void structure_tensor(cv::Mat const &gray, size_t const &wr,
+                      cv::Mat &eigenmin, cv::Mat &eigenmax,
+                      cv::Rect const &roi);
+// @param buf: Scratch space, reused across calls.
+void structure_tensor(cv::Mat const &gray, size_t const &wr,
+                      cv::Mat &eigenmin, cv::Mat &eigenmax,
+                      cv::Rect const &roi, std::vector<double> &buf);
+
 // @brief Compute eigenvalues of given symmetric matrix [a, b; b, c].
 // @return A tuple with {minEvalue, maxEvalue}.
 std::tuple<double, double> eigen(double const &a, double const &b,
@@ -27,7 +45,61 @@ double getsum(cv::Mat const &from, size_t const &rlb, size_t const &clb,
 template <typename T> T constexpr sq(T const &x) { return x * x; }
 
 // @brief Perfrom non-maximum suppression with thresholding
-cv::Mat nms(cv::Mat const &frame);
+// @param radius: Pixels are kept if they are the maximum of their (2 *
+// `radius` + 1)^2 neighborhood.
+cv::Mat nms(cv::Mat const &frame, int const &radius = 1);
+
+// @brief Threshold used by `nms()`, the value of the max(30, .0001 * size)-th
+// largest response of `frame`.  Selected in place, `frame` is not copied.
+float nms_threshold(cv::Mat const &frame);
+
+// @brief Append pixels of `roi` in `frame` that pass non-maximum suppression
+// with given `threshold` to `corners`.
+void nms(cv::Mat const &frame, float const &threshold, cv::Rect const &roi,
+         std::vector<cv::Point2i> &corners, int const &radius = 1);
+
+// @brief Harris corner detector for a stream of frames of one resolution.
+// Buffers are allocated up front and reused, so that `detect()` does not
+// allocate once the stream has warmed up.
+class HarrisDetector {
+  private:
+    // Window radius
+    size_t wr;
+    // Radius of non-maximum suppression
+    int nmsr = 1;
+    // Frame size the buffers are allocated for
+    cv::Size size;
+    // Directory of debug image dumps, empty if disabled
+    std::string dumpdir;
+    // Grayscale frame, unused if frames are grayscale already
+    cv::Mat gray;
+    // Minimum/maximum eigenvalues of each window
+    cv::Mat eigenmin, eigenmax;
+    // Per-thread scratch space of `structure_tensor()`
+    std::vector<std::vector<double>> scratch;
+    // Per-thread corners
+    std::vector<std::vector<cv::Point2i>> local;
+    // Corners of the last frame
+    std::vector<cv::KeyPoint> corners;
+
+    // Reallocate buffers for frames of given size.
+    void resize(cv::Size const &size);
+
+  public:
+    HarrisDetector(cv::Size const &size, size_t const &wr = 1);
+
+    // Radius of the neighborhood of non-maximum suppression, see `nms()`.
+    void set_nms_radius(int const &radius);
+    // Save eigenvalue images of every frame to `dir`, empty disables.
+    void set_dump(std::string const &dir);
+    // Detect corners in `frame`, the result is valid until the next call.
+    // The response of each keypoint is its minimum eigenvalue.
+    std::vector<cv::KeyPoint> const &detect(cv::Mat const &frame);
+    // Draw markers at corners of the last frame.
+    void draw(cv::Mat &frame) const;
+    // Minimum eigenvalues of the last frame.
+    cv::Mat const &min_eigenvalues() const { return this->eigenmin; }
+};
 
 }; // namespace pa2
 
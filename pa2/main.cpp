@@ -1,11 +1,129 @@
+#include "RingBuffer.hpp"
 #include "Timer.hpp"
 #include "pa2.hpp"
 
 #include <opencv2/opencv.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <string>
+#include <thread>
+
+using clk = std::chrono::steady_clock;
+
+// Frame passed through the stages of the continuous pipeline
+struct Frame {
+    // Image, with markers at the corners after the detect stage
+    cv::Mat image;
+    // When the capture stage got the frame
+    clk::time_point captured;
+};
+
+// Latency counter of a pipeline stage, only updated by the stage's own
+// thread.
+struct Latency {
+    size_t count{0};
+    double total{0};
+    double max{0};
+
+    void add(clk::time_point const &from, clk::time_point const &to) {
+        double ms =
+            std::chrono::duration<double, std::milli>(to - from).count();
+        this->count++;
+        this->total += ms;
+        this->max = std::max(this->max, ms);
+    }
+    void print(char const *name) const {
+        fprintf(stderr, "%-10s %6zu frames, %7.2f ms avg, %7.2f ms max\n",
+                name, this->count,
+                this->count ? this->total / this->count : 0., this->max);
+    }
+};
+
+// Runs decoding, detection and rendering on their own threads, until the
+// source ends or `q` is pressed.  Frames the detector can not keep up with
+// are dropped, so that the display stays at the frame rate of the source.
+int continuous(cv::VideoCapture &cap) {
+    // Frame interval of video files.  Cameras pace themselves, they have no
+    // frame count.
+    double        fps      = cap.get(cv::CAP_PROP_FPS);
+    clk::duration interval = clk::duration::zero();
+    if (fps > 0 && cap.get(cv::CAP_PROP_FRAME_COUNT) > 0) {
+        interval = std::chrono::duration_cast<clk::duration>(
+            std::chrono::duration<double>(1. / fps));
+    }
+    cv::Size            size(cap.get(cv::CAP_PROP_FRAME_WIDTH),
+                             cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    pa2::HarrisDetector detector(size, 1);
+
+    // Capture -> detect keeps only the newest frames, detect -> render
+    // never blocks the detector for long.
+    RingBuffer<Frame> captured(2);
+    RingBuffer<Frame> detected(2);
+    std::atomic<bool> stop{false};
+    Latency           capture_latency, detect_latency, render_latency;
+    Latency           total_latency;
+
+    std::thread capture_thread([&] {
+        clk::time_point next = clk::now();
+        while (!stop) {
+            Frame           frame;
+            clk::time_point start = clk::now();
+            if (!cap.read(frame.image)) {
+                break;
+            }
+            frame.captured = clk::now();
+            capture_latency.add(start, frame.captured);
+            captured.push_latest(std::move(frame));
+            // Frames that were late are not made up for with a burst of
+            // reads, which would only be dropped.
+            next = std::max(next + interval, clk::now());
+            std::this_thread::sleep_until(next);
+        }
+        captured.close();
+    });
+
+    std::thread detect_thread([&] {
+        Frame frame;
+        while (!stop && captured.pop(frame)) {
+            clk::time_point start = clk::now();
+            detector.detect(frame.image);
+            detector.draw(frame.image);
+            detect_latency.add(start, clk::now());
+            if (!detected.push(std::move(frame))) {
+                break;
+            }
+        }
+        detected.close();
+    });
+
+    Frame frame;
+    char  key = 0;
+    while (key != 'q' && detected.pop(frame)) {
+        clk::time_point start = clk::now();
+        cv::imshow("Harris", frame.image);
+        key = cv::waitKey(1);
+        render_latency.add(start, clk::now());
+        total_latency.add(frame.captured, clk::now());
+    }
+    stop = true;
+    captured.close();
+    detected.close();
+    capture_thread.join();
+    detect_thread.join();
+
+    fprintf(stderr, "frame size is %dx%d, %zu frames dropped\n", size.width,
+            size.height, captured.dropped());
+    capture_latency.print("capture");
+    detect_latency.print("detect");
+    render_latency.print("render");
+    total_latency.print("end-to-end");
+
+    return 0;
+}
 
 int main(int argc, char **argv) {
     /* [Variables] */
@@ -14,6 +132,8 @@ int main(int argc, char **argv) {
     std::string ifile{""};
     // Treat input file as a video by default
     bool isimage{false};
+    // Detect corners in every frame instead of paused ones only
+    bool iscontinuous{false};
     // Last pressed key
     char key{0};
     // Image
@@ -34,6 +154,9 @@ int main(int argc, char **argv) {
         if (!strcmp(argv[i], "-i") || !strcmp(argv[i], "--image")) {
             isimage = true;
         }
+        if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--continuous")) {
+            iscontinuous = true;
+        }
         ifile = argv[i];
     }
     if (ifile.length() == 0) {
@@ -63,6 +186,9 @@ int main(int argc, char **argv) {
                     ifile.c_str());
             return 1;
         }
+        if (iscontinuous) {
+            return continuous(cap);
+        }
         elapse = 1000 / cap.get(cv::CAP_PROP_FPS);
         while (cap.isOpened() && key != 'q') {
             if (key == ' ') {